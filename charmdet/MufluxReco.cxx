@@ -15,24 +15,46 @@
 #include "ShipMCTrack.h"
 #include "MufluxSpectrometerHit.h"
 #include "MuonTaggerHit.h"
+#include "TrackFitService.h"
+#include "TChainElement.h"
 #include <algorithm>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
 
-TVector3* parallelToZ = new TVector3(0., 0., 1.);
-TVector3* NewPosition = new TVector3(0., 0., 0.);
+const TVector3 parallelToZ(0., 0., 1.);
+// guards gROOT's list of objects while workers clone histograms
+static std::mutex histoMutex;
 std::vector<int> charmExtern = {4332,4232,4132,4232,4122,431,411,421};
 std::vector<int> beautyExtern = {5332,5232,5132,5232,5122,531,511,521};
 std::vector<int> muSources   = {221,223,333,113,331};
 // -----   Standard constructor   ------------------------------------------ 
-MufluxReco::MufluxReco() {}
+MufluxReco::MufluxReco() : nThreads(1), fWorker(kFALSE), fRandom(0) {}
 // -----   Standard constructor   ------------------------------------------ 
-MufluxReco::MufluxReco(TTreeReader* t)
+MufluxReco::MufluxReco(TTreeReader* t) : nThreads(1), fWorker(kFALSE), fRandom(0)
 {
   xSHiP = t;
   MCdata = false;
   if (xSHiP->GetTree()->GetBranch("MCTrack")){MCdata=true;}
   std::cout << "MufluxReco initialized for "<<xSHiP->GetEntries(true) << " events "<<std::endl;
   xSHiP->ls();
+  bindBranches();
+}
+// -----   Worker copy, see runParallel   ---------------------------------- 
+MufluxReco::MufluxReco(const MufluxReco& master, TTree* t)
+  : MCdata(master.MCdata), noisyChannels(master.noisyChannels), deadChannels(master.deadChannels),
+    cuts(master.cuts), RPCPositions(master.RPCPositions), DTPositionsTop(master.DTPositionsTop),
+    DTPositionsBot(master.DTPositionsBot), effFudgeFac(master.effFudgeFac),
+    nThreads(1), fWorker(kTRUE), fRandom(0)
+{
+  xSHiP = new TTreeReader(t);
+  bindBranches();
+}
+
+void MufluxReco::bindBranches()
+{
   FitTracks = 0;
   TrackInfos = 0;
   RPCTrackY = 0;
@@ -244,7 +266,7 @@ Int_t MufluxReco::checkDiMuon(){
    Int_t channel = -1;
    std::vector<int> processed;
    Double_t weight;
-   TH2D* h_weightVsSource=(TH2D*)(gDirectory->GetList()->FindObject("weightVsSource"));
+   TH2D* h_weightVsSource=(TH2D*)(hist("weightVsSource"));
    for (Int_t n=0;n<MufluxSpectrometerPoints->GetEntries();n++) {
       MufluxSpectrometerPoint* hit = (MufluxSpectrometerPoint*)MufluxSpectrometerPoints->At(n);
       Int_t i = hit->GetTrackID();
@@ -306,11 +328,19 @@ Bool_t MufluxReco::findSimpleEvent(Int_t nmin, Int_t nmax){
 
 void MufluxReco::RPCextrap(Int_t nMax){
  Int_t N = xSHiP->GetEntries(true);
- TTree* sTree = xSHiP->GetTree();
  if (nMax<0){nMax=N;}
  xSHiP->Restart();
  gROOT->cd();
  std::cout<< "make RPC analysis: "<< N <<std::endl;
+ if (nThreads>1){
+   runParallel(nMax, [](MufluxReco& r, Long64_t first, Long64_t last){ r.RPCextrapRange(first, last); });
+ }else{
+   RPCextrapRange(0, nMax);
+ }
+}
+
+void MufluxReco::RPCextrapRange(Long64_t first, Long64_t last){
+ TTree* sTree = xSHiP->GetTree();
  std::map<int,TH2D*> h_RPCResX;
  std::map<int,TH2D*> h_RPCResY;
  std::map<int,TH1D*> h_RPCextTrack;
@@ -321,28 +351,28 @@ void MufluxReco::RPCextrap(Int_t nMax){
  for ( int s = 1; s<6; s++ )   {
   for ( int v = 0; v<2; v++ )   {
    hname = "RPCResY_";
-   h_RPCResY[s*10+v]=(TH2D*)(gDirectory->GetList()->FindObject(hname+=(s*10+v)));
+   h_RPCResY[s*10+v]=(TH2D*)(hist(hname+=(s*10+v)));
    hname = "RPCResX_";
-   h_RPCResX[s*10+v]=(TH2D*)(gDirectory->GetList()->FindObject(hname+=(s*10+v)));
+   h_RPCResX[s*10+v]=(TH2D*)(hist(hname+=(s*10+v)));
    hname = "RPCextTrack_";
-   h_RPCextTrack[s*10+v]=(TH1D*)(gDirectory->GetList()->FindObject(hname+=(s*10+v)));
+   h_RPCextTrack[s*10+v]=(TH1D*)(hist(hname+=(s*10+v)));
    hname = "RPCfired_";
-   h_RPCfired[s*10+v]=(TH1D*)(gDirectory->GetList()->FindObject(hname+=(s*10+v)));
+   h_RPCfired[s*10+v]=(TH1D*)(hist(hname+=(s*10+v)));
   }
   hname = "RPCfired_or_";
-  h_RPCfired_or[s]=(TH1D*)(gDirectory->GetList()->FindObject(hname+=(s)));
+  h_RPCfired_or[s]=(TH1D*)(hist(hname+=(s)));
   }
  for ( int k = 2; k<20; k++ )   {
   hname = "RPC<";hname+=(k);hname+="_p";
-  h_RPC[k]=(TH1D*)(gDirectory->GetList()->FindObject(hname));
+  h_RPC[k]=(TH1D*)(hist(hname));
  }
- TH1D* h_RPC_p =  (TH1D*)(gDirectory->GetList()->FindObject("RPC_p"));
- TH2D* h_RPCResX1_p =  (TH2D*)(gDirectory->GetList()->FindObject("RPCResX1_p"));
- TH2D* h_RPC_2XY =  (TH2D*)(gDirectory->GetList()->FindObject("RPC<2XY"));
- TH3D* h_RPCMatchedHits =  (TH3D*)(gDirectory->GetList()->FindObject("RPCMatchedHits"));
+ TH1D* h_RPC_p =  (TH1D*)(hist("RPC_p"));
+ TH2D* h_RPCResX1_p =  (TH2D*)(hist("RPCResX1_p"));
+ TH2D* h_RPC_2XY =  (TH2D*)(hist("RPC<2XY"));
+ TH3D* h_RPCMatchedHits =  (TH3D*)(hist("RPCMatchedHits"));
 
- Int_t nx = 0;
- while (nx<nMax){
+ Long64_t nx = first;
+ while (nx<last){
    sTree->GetEvent(nx);
    nx+=1;
    Int_t Nhits = Digi_MuonTaggerHits->GetEntries();
@@ -443,14 +473,14 @@ Double_t MufluxReco::extrapolateToPlane(genfit::Track* fT,Float_t z, TVector3& p
       }
     }
     genfit::StateOnPlane fstate =  fT->getFittedState(mClose);
-    NewPosition->SetXYZ(0., 0., z);
+    TVector3 newPosition(0., 0., z);
     Int_t pdgcode = -int(13*fstate.getCharge());
     genfit::RKTrackRep* rep      = new genfit::RKTrackRep( pdgcode );
     genfit::StateOnPlane* state   = new genfit::StateOnPlane(rep);
     auto Pos = fstate.getPos();
     auto Mom = fstate.getMom();
     rep->setPosMom(*state,Pos,Mom);
-    rc = rep->extrapolateToPlane(*state, *NewPosition, *parallelToZ );
+    rc = rep->extrapolateToPlane(*state, newPosition, parallelToZ );
     pos = (state->getPos());
     mom = (state->getMom());
     delete rep;
@@ -533,13 +563,21 @@ Double_t MufluxReco::findTrueMomentum(TTree* sTree){
 
 void MufluxReco::trackKinematics(Float_t chi2UL, Int_t nMax){
  Int_t N = xSHiP->GetEntries(true);
- TTree* sTree = xSHiP->GetTree();
  if (nMax<0){nMax=N;}
  xSHiP->Restart();
  gROOT->cd();
  std::cout<< "fill trackKinematics: "<< N <<std::endl;
+ if (nThreads>1){
+   runParallel(nMax, [chi2UL](MufluxReco& r, Long64_t first, Long64_t last){ r.trackKinematicsRange(chi2UL, first, last); });
+ }else{
+   trackKinematicsRange(chi2UL, 0, nMax);
+ }
+}
+
+void MufluxReco::trackKinematicsRange(Float_t chi2UL, Long64_t first, Long64_t last){
+ TTree* sTree = xSHiP->GetTree();
 
- TH1D* h_Trscalers =  (TH1D*)(gDirectory->GetList()->FindObject("Trscalers"));
+ TH1D* h_Trscalers =  (TH1D*)(hist("Trscalers"));
 
  std::map<TString,TH1D*> h1D;
  std::map<TString,TH2D*> h2D;
@@ -556,18 +594,18 @@ void MufluxReco::trackKinematics(Float_t chi2UL, Int_t nMax){
    std::vector<TString>::iterator it1 = h1names.begin();
    while( it1!=h1names.end()){
     TString hname = *it1+*itt+*its; 
-    h1D[hname] = (TH1D*)(gDirectory->GetList()->FindObject(hname));
+    h1D[hname] = (TH1D*)(hist(hname));
     it1++;}
    std::vector<TString>::iterator it2 = h2names.begin();
    while( it2!=h2names.end()){
     TString hname = *it2+*itt+*its;
-    h2D[hname] = (TH2D*)(gDirectory->GetList()->FindObject(hname));
+    h2D[hname] = (TH2D*)(hist(hname));
     it2++;}
    itt++;}
   its++;}
 
- Int_t nx = 0;
- while (nx<nMax){
+ Long64_t nx = first;
+ while (nx<last){
    sTree->GetEvent(nx);
    h_Trscalers->Fill(1);
    nx+=1;
@@ -603,7 +641,7 @@ void MufluxReco::trackKinematics(Float_t chi2UL, Int_t nMax){
        bool failed = false;
        for ( it = detectors.begin(); it != detectors.end(); it++ ){
         for ( int m=0; m<hitsPerStation[it->first.Data()].size();m+=1){
-         float rnr = gRandom->Uniform();
+         float rnr = rnd()->Uniform();
          float eff = effFudgeFac[it->first.Data()];
          if (rnr < eff){detectors[it->first.Data()]+=1;}
         }
@@ -763,7 +801,7 @@ void MufluxReco::sortHits(TClonesArray* hits, nestedList* l, Bool_t flag){
     hit->Dump();
    }else{
      if (MCdata){
-      float rnr = gRandom->Uniform();
+      float rnr = rnd()->Uniform();
       TString station;
       if (info[4]==0){station = 'x';station += info[0];}
       if (info[4]==1){station = 'u';}
@@ -779,33 +817,49 @@ void MufluxReco::sortHits(TClonesArray* hits, nestedList* l, Bool_t flag){
 
 void MufluxReco::fillHitMaps(Int_t nMax)
 {
- Float_t deadThreshold = 1.E-4; // ~1% typical occupancy
  Int_t N = xSHiP->GetEntries(true);
  if (nMax<0){nMax=N;}
  xSHiP->Restart();
  gROOT->cd();
  std::cout<< "fillHitMaps: "<< N  <<std::endl;
+ if (nThreads>1){
+   runParallel(nMax, [](MufluxReco& r, Long64_t first, Long64_t last){ r.fillHitMapsRange(first, last); });
+ }else{
+   fillHitMapsRange(0, nMax);
+ }
+}
+
+void MufluxReco::fillHitMapsRange(Long64_t first, Long64_t last)
+{
+ Float_t deadThreshold = 1.E-4; // ~1% typical occupancy
  TTreeReaderArray <MufluxSpectrometerHit> Digi_MufluxSpectrometerHits(*xSHiP, "Digi_MufluxSpectrometerHits");
  TTreeReaderValue<FairEventHeader>* rvShipEventHeader= NULL;
  if (MCdata){ rvShipEventHeader = new TTreeReaderValue<FairEventHeader>(*xSHiP, "ShipEventHeader");}
- Int_t nx = 0;
- while (xSHiP->Next()){
+ // histograms by numeric key, names are only built the first time a key is seen
+ std::unordered_map<Int_t,TH1D*> layerHistos;
+ std::unordered_map<Int_t,TH1D*> TDCHistos;
+ std::unordered_map<Int_t,TH1D*> channelHistos;
+ Long64_t nx = first;
+ while (nx<last && xSHiP->SetEntry(nx)==TTreeReader::kEntryValid){
   nx+=1;
-  if (nx>nMax){break;}
   // std::cout<< "next event. #hits "<< Digi_MufluxSpectrometerHits.GetSize()  <<std::endl;
   for (Int_t k=0;k<Digi_MufluxSpectrometerHits.GetSize();k++) {
      MufluxSpectrometerHit* hit = &(Digi_MufluxSpectrometerHits[k]);
      auto info = hit->StationInfo();
      Int_t s=info[0]; Int_t v=info[1]; Int_t p=info[2]; Int_t l=info[3]; Int_t channelNr=info[5]; 
      Int_t tdcId=info[6]; Int_t nRT=info[7]/cuts["RTsegmentation"];
-     TString view = "_x"; 
-     if (info[4]==1){view="_u";}
-     if (info[4]==2){view="_v";}
-     TString tot = "";
-     if (!hit->hasTimeOverThreshold()){ tot = "_noToT";}
-     TString histo; histo.Form("%d",1000*s+100*p+10*l);histo+=view;
-     TH1D* h = (TH1D*)(gDirectory->GetList()->FindObject(histo));
+     Int_t layerKey = 4*(1000*s+100*p+10*l)+info[4];
+     auto hl = layerHistos.find(layerKey);
+     if (hl==layerHistos.end()){
+       TString view = "_x"; 
+       if (info[4]==1){view="_u";}
+       if (info[4]==2){view="_v";}
+       TString histo; histo.Form("%d",1000*s+100*p+10*l);histo+=view;
+       hl = layerHistos.emplace(layerKey, (TH1D*)(hist(histo))).first;
+     }
+     TH1D* h = hl->second;
      if (!h){
+       TString histo; histo.Form("%d",1000*s+100*p+10*l);histo+=(info[4]==1?"_u":(info[4]==2?"_v":"_x"));
        std::cout<< "fillHitMaps: ERROR histo not known "<< histo <<" event "<< nx <<std::endl;
        continue;
      }
@@ -814,21 +868,123 @@ void MufluxReco::fillHitMaps(Int_t nMax)
      if (check!=noisyChannels.end()){ continue;}
      Float_t t0 = 0;
      if (MCdata){ rvShipEventHeader->Get()->GetEventTime(); }
-     TString TDChisto = "TDC"; TDChisto+=nRT; TDChisto+=tot;
-     h = (TH1D*)(gDirectory->GetList()->FindObject(TDChisto));
+     Int_t TDCKey = 2*nRT+(hit->hasTimeOverThreshold()?0:1);
+     auto ht = TDCHistos.find(TDCKey);
+     if (ht==TDCHistos.end()){
+       TString TDChisto = "TDC"; TDChisto+=nRT; if (!hit->hasTimeOverThreshold()){ TDChisto+="_noToT";}
+       ht = TDCHistos.emplace(TDCKey, (TH1D*)(hist(TDChisto))).first;
+     }
+     h = ht->second;
      if (!h){
+       TString TDChisto = "TDC"; TDChisto+=nRT; if (!hit->hasTimeOverThreshold()){ TDChisto+="_noToT";}
        std::cout<< "fillHitMaps: ERROR histo not known "<< TDChisto  <<" event "<< nx <<std::endl; 
        continue;
      }
      h->Fill( hit->GetDigi()-t0);
-     TString channel = "TDC";channel+=hit->GetDetectorID();
-     h = (TH1D*)(gDirectory->GetList()->FindObject(channel));
+     auto hc = channelHistos.find(hit->GetDetectorID());
+     if (hc==channelHistos.end()){
+       TString channel = "TDC";channel+=hit->GetDetectorID();
+       hc = channelHistos.emplace(hit->GetDetectorID(), (TH1D*)(hist(channel))).first;
+     }
+     h = hc->second;
      h->Fill( hit->GetDigi()-t0);
    }
   }
+ delete rvShipEventHeader;
 }
+
+TH1* MufluxReco::hist(const TString& name)
+{
+ if (!fWorker){ return (TH1*)(gDirectory->GetList()->FindObject(name));}
+ auto it = fWorkerHistos.find(name);
+ if (it!=fWorkerHistos.end()){ return it->second.second;}
+ // first use in this worker: private empty copy of the histogram in gROOT
+ TH1* orig = 0;
+ TH1* copy = 0;
+ {
+  std::lock_guard<std::mutex> lock(histoMutex);
+  orig = (TH1*)(gROOT->GetList()->FindObject(name));
+  if (orig){
+    copy = (TH1*)(orig->Clone());
+    copy->SetDirectory(0);
+    copy->Reset();
+  }
+ }
+ fWorkerHistos[name] = std::make_pair(orig, copy);
+ return copy;
+}
+
+TRandom* MufluxReco::rnd()
+{
+ if (fRandom){ return fRandom;}
+ return gRandom;
+}
+
+TTree* MufluxReco::openInputCopy()
+{
+ TTree* t = xSHiP->GetTree();
+ TChain* copy = new TChain(t->GetName());
+ TChain* chain = dynamic_cast<TChain*>(t);
+ if (chain){
+   TIter next(chain->GetListOfFiles());
+   TChainElement* element;
+   while ((element = (TChainElement*)next())){ copy->Add(element->GetTitle());}
+ }else if (t->GetCurrentFile()){
+   copy->Add(t->GetCurrentFile()->GetName());
+ }else{
+   delete copy;
+   return 0;
+ }
+ return copy;
+}
+
+void MufluxReco::runParallel(Long64_t nMax, std::function<void(MufluxReco&, Long64_t, Long64_t)> loop)
+{
+ Int_t nWorkers = TMath::Max(1, (Int_t)TMath::Min((Long64_t)nThreads, nMax));
+ // one reader, tree and random generator per worker, set up here in the main thread
+ std::vector<std::unique_ptr<MufluxReco>> workers;
+ for (Int_t w=0;w<nWorkers;w++){
+   TTree* t = openInputCopy();
+   if (!t){
+     std::cout<< "MufluxReco: input is not file based, running serially"<<std::endl;
+     loop(*this, 0, nMax);
+     return;
+   }
+   workers.emplace_back(new MufluxReco(*this, t));
+   workers.back()->fRandom = new TRandom3(rnd()->Integer(kMaxInt)+1);
+ }
+ genfit::TrackFitService::prepareThreads(nWorkers);
+ std::vector<std::thread> threads;
+ for (Int_t w=0;w<nWorkers;w++){
+   Long64_t first = nMax*w/nWorkers;
+   Long64_t last  = nMax*(w+1)/nWorkers;
+   MufluxReco* worker = workers[w].get();
+   threads.emplace_back([worker, first, last, &loop](){
+     genfit::TrackFitService::ThreadContext context;
+     loop(*worker, first, last);
+   });
+ }
+ for (auto& t : threads){ t.join();}
+ // add the private histograms to the ones in gROOT
+ for (auto& worker : workers){
+   for (auto& h : worker->fWorkerHistos){
+     if (h.second.first && h.second.second){ h.second.first->Add(h.second.second);}
+   }
+ }
+}
+
 // -----   Destructor   ----------------------------------------------------
-MufluxReco::~MufluxReco() { }
+MufluxReco::~MufluxReco()
+{
+ if (!fWorker){ return;}
+ for (auto& h : fWorkerHistos){ delete h.second.second;}
+ delete fRandom;
+ TTree* t = xSHiP->GetTree();
+ delete xSHiP;
+ delete t;
+ delete MCTrack; delete FitTracks; delete TrackInfos; delete RPCTrackY; delete RPCTrackX;
+ delete Digi_MuonTaggerHits; delete cDigi_MufluxSpectrometerHits; delete MufluxSpectrometerPoints;
+}
 // -------------------------------------------------------------------------
 
  
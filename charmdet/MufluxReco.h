@@ -15,6 +15,10 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <functional>
+
+class TH1;
+class TRandom;
 
 enum class view {x, u, v, y}; // to avoid using std::string to index
 typedef std::map<std::string,float> StringFloatMap;
@@ -50,8 +54,27 @@ public:
    StringVecIntMap countMeasurements(TrackInfo* trInfo);
    std::vector<std::vector<int>> GroupIntegers(std::vector<int>& input_array, size_t span);
    void setEffFudgeFactor(std::string s,float f){effFudgeFac[s]=f;}
+   /** Run fillHitMaps, RPCextrap and trackKinematics on n threads, 1 (default) is serial.
+       Each thread reads its own copy of the input over a contiguous entry range and fills
+       private copies of the histograms, which are added to the histograms in gROOT at the end.
+       With MC data the efficiency smearing then uses one random generator per thread. **/
+   void setNThreads(Int_t n){nThreads = n;}
 
 private:
+    /** Worker copy of master reading tree t, used by runParallel **/
+    MufluxReco(const MufluxReco& master, TTree* t);
+    void bindBranches();
+    /** Histogram by name: from gDirectory, or a private copy in a worker **/
+    TH1* hist(const TString& name);
+    TRandom* rnd();
+    /** Own chain with the same files as the input, NULL if the input is not file based **/
+    TTree* openInputCopy();
+    /** Split entries [0, nMax) over nThreads workers, run loop on each and merge the histograms **/
+    void runParallel(Long64_t nMax, std::function<void(MufluxReco&, Long64_t, Long64_t)> loop);
+    void fillHitMapsRange(Long64_t first, Long64_t last);
+    void RPCextrapRange(Long64_t first, Long64_t last);
+    void trackKinematicsRange(Float_t chi2UL, Long64_t first, Long64_t last);
+
   protected:
     Bool_t MCdata;
     TTreeReader* xSHiP;
@@ -78,6 +101,10 @@ private:
     TBranch        *b_Digi_MuonTaggerHits;   //!
     TBranch        *b_Digi_MufluxSpectrometerHits;   //!
     TBranch        *b_MufluxSpectrometerPoints;   //!
+    Int_t nThreads;                              //! number of threads for the event loops
+    Bool_t fWorker;                              //! worker copy, owns its input
+    TRandom* fRandom;                            //! worker random generator
+    std::map<TString,std::pair<TH1*,TH1*>> fWorkerHistos; //! original and private copy
    ClassDef(MufluxReco,5);
 };
 
@@ -18,7 +18,7 @@ class ecalCell : public TObject
 public:
   ecalCell(Int_t cellnumber, Float_t x1=0, Float_t y1=0, Float_t x2=0, Float_t y2=0, Char_t type=0, Float_t energy=0) 
     : TObject(), fNumber(cellnumber), fX1(x1), fY1(y1), fX2(x2),
-    fY2(y2), fType(type), fEnergy(energy), fADC(-1111), fNeighbors(), f5x5Cluster(),fTime(-1111)
+    fY2(y2), fType(type), fEnergy(energy), fADC(-1111), fNeighbors(), f5x5Cluster(),fTime(-1111), fIndex(-1)
   {};
 
   inline Bool_t IsInside(Float_t x, Float_t y) {return x>GetX1()&&x<GetX2()&&y>GetY1()&&y<GetY2();}
@@ -38,6 +38,9 @@ public:
   inline Short_t GetADC() const {return fADC;}
 
   inline Int_t   GetCellNumber() const {return fNumber;}
+  /** Position of the cell in the ecalStructure cell arrays, -1 if not set **/
+  inline Int_t   GetIndex() const {return fIndex;}
+  inline void    SetIndex(Int_t index) {fIndex=index;}
 	
   inline Float_t GetEnergy() const {return fEnergy;}
   Float_t GetTime() const {return fTime;}
@@ -102,6 +105,8 @@ private:
 
   /** Time of cell to fire **/
   Double_t fTime;
+  /** Position of the cell in the ecalStructure cell arrays **/
+  Int_t fIndex;		//!
 
   ClassDef(ecalCell,1);
 };
@@ -98,8 +98,10 @@ void ecalClusterFinder::FormPreClusters()
   list<ecalCell*> all;
   list<ecalCell*>::const_iterator p;
   list<ecalCell*>::const_iterator p2;
-  list<ecalCell*> cls;
   list<ecalCell*> cls2;
+  ecalCell** cls;
+  Int_t nc;
+  Int_t k;
   ecalCell* cell;
   ecalCell* min;
   Double_t e;
@@ -128,14 +130,14 @@ void ecalClusterFinder::FormPreClusters()
         if (find(cls.begin(), cls.end(), *p2)==cls.end()) cls.push_back(*p2);
     }
 */
-    cell->Get5x5Cluster(cls);
+    cls=fStr->Get5x5Cluster(cell->GetIndex(), nc);
     ecls=0.0;
-    for(p=cls.begin();p!=cls.end();++p)
-      ecls+=(*p)->GetEnergy();
+    for(k=0;k<nc;k++)
+      ecls+=cls[k]->GetEnergy();
 //    cout << ":" << ecls << endl;
     /** Remove low energy clusters **/
     if (ecls<fMinClusterE) continue;
-    precluster=new ecalPreCluster(cls, max);
+    precluster=new ecalPreCluster(cls, nc, max);
     fPreClusters.push_back(precluster);
   }
 }
@@ -93,6 +93,8 @@ void ecalDigi::Exec(Option_t* option)
   ecalCell* cell;
   list<ecalCell*> cells;
   fStr->GetCells(cells);
+  /** Every cell gets a new value **/
+  fStr->MarkAllFired();
   list<ecalCell*>::const_iterator p=cells.begin();
   Short_t adc;
 
@@ -9,7 +9,7 @@
 
 #include "TClonesArray.h"
 
-#include <list>
+#include <vector>
 #include <iostream>
 
 using namespace std;
@@ -72,10 +72,10 @@ void ecalMaximumLocator::Finish()
 
 void ecalMaximumLocator::Exec(const Option_t* opt)
 {
-  list<ecalCell*> all;
-  list<ecalCell*> cells;
-  list<ecalCell*>::const_iterator p;
-  list<ecalCell*>::const_iterator r;
+  ecalCell* cell;
+  ecalCell** cells;
+  Int_t nc;
+  Int_t k;
   Double_t e;
   Double_t z=fStr->GetEcalInf()->GetZPos();
   Double_t r1;
@@ -85,32 +85,35 @@ void ecalMaximumLocator::Exec(const Option_t* opt)
 
   fEvent++;
   fMaximums->Clear();
-  fStr->GetCells(all);
-  for(p=all.begin();p!=all.end();++p)
+  /** Only cells fired in this event can be maximums **/
+  const vector<Int_t>& fired=fStr->GetFiredCells();
+  vector<Int_t>::const_iterator p;
+  for(p=fired.begin();p!=fired.end();++p)
   {
-    e=(*p)->GetEnergy();
-    r1=(*p)->GetCenterX(); r1*=r1;
-    t=(*p)->GetCenterY(); t*=t;
-    r1=TMath::Sqrt(r1*r1+t*t);
+    cell=fStr->GetCellByIndex(*p);
+    e=cell->GetEnergy();
     if (e<fECut)
       continue;
-    (*p)->GetNeighborsList(cells);
-    for(r=cells.begin();r!=cells.end();++r)
+    r1=cell->GetCenterX(); r1*=r1;
+    t=cell->GetCenterY(); t*=t;
+    r1=TMath::Sqrt(r1*r1+t*t);
+    cells=fStr->GetNeighbors(*p, nc);
+    for(k=0;k<nc;k++)
     {
-      if ((*r)->GetEnergy()<e) continue;
-      if ((*r)->GetEnergy()==e)
+      if (cells[k]->GetEnergy()<e) continue;
+      if (cells[k]->GetEnergy()==e)
       {
-        r2=(*r)->GetCenterX(); r2*=r2;
-        t=(*r)->GetCenterY(); t*=t;
+        r2=cells[k]->GetCenterX(); r2*=r2;
+        t=cells[k]->GetCenterY(); t*=t;
         r2=TMath::Sqrt(r2*r2+t*t);
 	if (r1>=r2) continue;
       }
       break;
     }
-    if (r!=cells.end())
+    if (k!=nc)
       continue;
-//    cout << e << " : " << (*p)->GetCenterX() << ", " << (*p)->GetCenterY() << endl;
-    new ((*fMaximums)[n++]) ecalMaximum(*p, z);
+//    cout << e << " : " << cell->GetCenterX() << ", " << cell->GetCenterY() << endl;
+    new ((*fMaximums)[n++]) ecalMaximum(cell, z);
   }
   if (fVerbose>9)
     Info("Exec", "%d maximums found", n);
@@ -59,6 +59,30 @@ void ecalStructure::Serialize()
     vector<ecalCell*> cells=fStructure[i]->GetCells();
     copy(cells.begin(),cells.end(), back_inserter(fCells));
   }
+  for(UInt_t i=0;i<fCells.size();i++)
+    fCells[i]->SetIndex(i);
+
+  /** Flatten neighbors lists and 5x5 clusters once, so per event loops
+   ** don't copy lists **/
+  list<ecalCell*> cells;
+  fNeighborStart.assign(1, 0);
+  fNeighborCells.clear();
+  f5x5Start.assign(1, 0);
+  f5x5Cells.clear();
+  for(UInt_t i=0;i<fCells.size();i++)
+  {
+    fCells[i]->GetNeighborsList(cells);
+    fNeighborCells.insert(fNeighborCells.end(), cells.begin(), cells.end());
+    fNeighborStart.push_back(fNeighborCells.size());
+    fCells[i]->Get5x5Cluster(cells);
+    f5x5Cells.insert(f5x5Cells.end(), cells.begin(), cells.end());
+    f5x5Start.push_back(f5x5Cells.size());
+  }
+
+  fFired.clear();
+  fFired.reserve(fCells.size());
+  fIsFired.assign(fCells.size(), kFALSE);
+  fFiredSorted=kTRUE;
 }
 
 //-----------------------------------------------------------------------------
@@ -76,6 +100,13 @@ ecalStructure::ecalStructure(ecalInf* ecalinf)
     fEcalInf(ecalinf),
     fStructure(),
     fCells(),
+    fNeighborStart(),
+    fNeighborCells(),
+    f5x5Start(),
+    f5x5Cells(),
+    fFired(),
+    fIsFired(),
+    fFiredSorted(kTRUE),
     fHash()
 {
   fX1=fEcalInf->GetXPos()-\
@@ -311,17 +342,44 @@ void ecalStructure::CreateNLists(ecalCell* cell)
 //-----------------------------------------------------------------------------
 void ecalStructure::ResetModules()
 {
-  list<ecalCell*>::const_iterator p=fCells.begin();
+  vector<Int_t>::const_iterator p=fFired.begin();
   if (fUseMC==0)
   {
-    for(;p!=fCells.end();++p)
-      (*p)->ResetEnergyFast();
+    for(;p!=fFired.end();++p)
+      fCells[*p]->ResetEnergyFast();
   }
   else
   {
-    for(;p!=fCells.end();++p)
-    ((ecalCellMC*)(*p))->ResetEnergy();
+    for(;p!=fFired.end();++p)
+    ((ecalCellMC*)fCells[*p])->ResetEnergy();
+  }
+  for(p=fFired.begin();p!=fFired.end();++p)
+    fIsFired[*p]=kFALSE;
+  fFired.clear();
+  fFiredSorted=kTRUE;
+}
+
+//-----------------------------------------------------------------------------
+void ecalStructure::MarkAllFired()
+{
+  fFired.resize(fCells.size());
+  for(UInt_t i=0;i<fCells.size();i++)
+    fFired[i]=i;
+  fIsFired.assign(fCells.size(), kTRUE);
+  fFiredSorted=kTRUE;
+}
+
+//-----------------------------------------------------------------------------
+const vector<Int_t>& ecalStructure::GetFiredCells()
+{
+  /** Keep the order of the full cells list, so results don't depend on
+   ** the order cells were filled in **/
+  if (!fFiredSorted)
+  {
+    sort(fFired.begin(), fFired.end());
+    fFiredSorted=kTRUE;
   }
+  return fFired;
 }
 
 //-----------------------------------------------------------------------------
@@ -42,10 +42,29 @@ public:
   Float_t GetY2() const;
   inline ecalInf* GetEcalInf() const {return fEcalInf;}
   inline void GetStructure(std::vector<ecalModule*>& stru) const {stru=fStructure;}
-  inline void GetCells(std::list<ecalCell*>& cells) const {cells=fCells;}
+  inline void GetCells(std::list<ecalCell*>& cells) const {cells.assign(fCells.begin(), fCells.end());}
+  inline Int_t GetNCells() const {return fCells.size();}
+  inline ecalCell* GetCellByIndex(Int_t index) const {return fCells[index];}
   //Create neighbors lists
   void CreateNLists(ecalCell* cell);
+  /** Reset cells fired in this event. Cells changed without MarkFired or
+   ** MarkAllFired are not reset. **/
   void ResetModules();
+
+  // Fired cells stuff
+  /** Register a cell which got energy in this event **/
+  inline void MarkFired(ecalCell* cell);
+  /** Register all cells, for tasks which touch every cell (digitization) **/
+  void MarkAllFired();
+  /** Indices of cells fired in this event, ascending **/
+  const std::vector<Int_t>& GetFiredCells();
+
+  /** Precomputed neighbors of the cell with given index: n cells from returned pointer **/
+  inline ecalCell** GetNeighbors(Int_t index, Int_t& n)
+    {n=fNeighborStart[index+1]-fNeighborStart[index]; return &fNeighborCells[fNeighborStart[index]];}
+  /** Precomputed 5x5 cluster of the cell with given index: n cells from returned pointer **/
+  inline ecalCell** Get5x5Cluster(Int_t index, Int_t& n)
+    {n=f5x5Start[index+1]-f5x5Start[index]; return &f5x5Cells[f5x5Start[index]];}
   
   ecalModule* CreateModule(char type, Int_t number, Float_t x1, Float_t y1, Float_t x2, Float_t y2);
   //Some usefull procedures for hit processing
@@ -69,7 +88,7 @@ private:
   Int_t GetNum(Int_t x, Int_t y) const;
   
 private:
-  /** Creates fCells lists **/
+  /** Creates fCells lists and neighbors arrays **/
   void Serialize();
   /** Use store MC information in cells **/
   Int_t fUseMC;
@@ -82,7 +101,19 @@ private:
   /** total list of ECAL modules **/
   std::vector<ecalModule*> fStructure;
   /** All ECAL cells **/
-  std::list<ecalCell*> fCells;
+  std::vector<ecalCell*> fCells;
+  /** Neighbors of cell i are fNeighborCells[fNeighborStart[i]..fNeighborStart[i+1]) **/
+  std::vector<Int_t> fNeighborStart;
+  std::vector<ecalCell*> fNeighborCells;
+  /** 5x5 clusters, same layout as neighbors **/
+  std::vector<Int_t> f5x5Start;
+  std::vector<ecalCell*> f5x5Cells;
+  /** Indices of cells fired in this event **/
+  std::vector<Int_t> fFired;
+  /** Is cell with given index in fFired? **/
+  std::vector<Bool_t> fIsFired;
+  /** Is fFired in ascending order? **/
+  Bool_t fFiredSorted;
   /** MCPoint id -> ECAL cell**/
   std::vector<__ecalCellWrapper*> fHash;
 
@@ -153,7 +184,10 @@ inline Bool_t ecalStructure::AddEnergy(Float_t x, Float_t y, Float_t energy, Boo
   {
     if (isPS) ; // cell->AddPSEnergy(energy); Preshower removed
     else
+    {
       cell->AddEnergy(energy);
+      MarkFired(cell);
+    }
   }
   else
     return kFALSE;
@@ -183,6 +217,16 @@ inline Int_t ecalStructure::GetHitId(Float_t x, Float_t y) const
     return -1111;
 }
 
+inline void ecalStructure::MarkFired(ecalCell* cell)
+{
+  /** Remember a cell to visit in maximum finding and reset **/
+  Int_t index=cell->GetIndex();
+  if (index<0||fIsFired[index]) return;
+  fIsFired[index]=kTRUE;
+  if (!fFired.empty()&&fFired.back()>index) fFiredSorted=kFALSE;
+  fFired.push_back(index);
+}
+
 struct __ecalCellWrapper
 {
 public:
@@ -121,7 +121,10 @@ void ecalStructureFiller::LoopForMCPoints()
       if (isPS)
         ; // cell->AddPSEnergy(pt->GetEnergyLoss()); preshower removed
       else
+      {
         cell->AddEnergy(pt->GetEnergyLoss());
+        fStr->MarkFired(cell);
+      }
     }
   }
   if (fStoreTrackInfo)
@@ -9,9 +9,32 @@
 #include "TFile.h"
 #include "TTree.h"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // Header of the binary (.bmap) field map format, written by convertMapToBinary.py.
+    // It is followed by the Bx, By, Bz values (Tesla) of each bin, in the same
+    // ascending z, y, x bin order as the ROOT and text maps
+    const char binaryMapMagic[8] = {'S','H','I','P','B','M','A','P'};
+    const UInt_t binaryMapVersion = 1;
+    struct BinaryMapHeader {
+	char magic[8];
+	UInt_t version;
+	UInt_t nComponents;
+	Float_t range[9]; // xMin, xMax, dx, yMin, yMax, dy, zMin, zMax, dz
+	UInt_t padding;
+	Long64_t nBins;
+    };
+    static_assert(sizeof(BinaryMapHeader) == 64, "binary field map header must be 64 bytes");
+}
+
 ShipBFieldMap::ShipBFieldMap(const std::string& label,
 			     const std::string& mapFileName,
 			     Float_t xOffset,
@@ -43,7 +66,11 @@ ShipBFieldMap::ShipBFieldMap(const std::string& label,
     scale_(scale),
     isSymmetric_(isSymmetric),
     theTrans_(0),
-    Tesla_(10.0)
+    Tesla_(10.0),
+    mapData_(0),
+    fieldUnit_(1.0),
+    mappedFile_(0),
+    mappedSize_(0)
 {
     this->initialise();
 }
@@ -57,6 +84,11 @@ ShipBFieldMap::~ShipBFieldMap()
 
     if (theTrans_) {delete theTrans_; theTrans_ = 0;}
 
+    // Release the memory-mapped binary map, which copies do not own
+    if (mappedFile_ && isCopy_ == kFALSE) {
+	munmap(mappedFile_, mappedSize_); mappedFile_ = 0;
+    }
+
 }
 
 
@@ -93,7 +125,11 @@ ShipBFieldMap::ShipBFieldMap(const std::string& newName, const ShipBFieldMap& rh
     scale_(newScale),
     isSymmetric_(rhs.isSymmetric_),
     theTrans_(0),
-    Tesla_(10.0)
+    Tesla_(10.0),
+    mapData_(rhs.mapData_),
+    fieldUnit_(rhs.fieldUnit_),
+    mappedFile_(rhs.mappedFile_),
+    mappedSize_(rhs.mappedSize_)
 {
     // Copy constructor with new label and different global offset, which uses
     // the same field map data (pointer) and distance units as the rhs object
@@ -101,6 +137,11 @@ ShipBFieldMap::ShipBFieldMap(const std::string& newName, const ShipBFieldMap& rh
 }
 
 void ShipBFieldMap::Field(const Double_t* position, Double_t* B)
+{
+    this->GetFieldValue(position, B);
+}
+
+void ShipBFieldMap::GetFieldValue(const Double_t* position, Double_t* B) const
 {
 
     // Set the B field components given the global position co-ordinates
@@ -170,30 +211,26 @@ void ShipBFieldMap::Field(const Double_t* position, Double_t* B)
     Int_t iY1(iY + 1);
     Int_t iZ1(iZ + 1);
 
-    binA_ = this->getMapBin(iX, iY, iZ);
-    binB_ = this->getMapBin(iX1, iY, iZ);
-    binC_ = this->getMapBin(iX, iY1, iZ);
-    binD_ = this->getMapBin(iX1, iY1, iZ);
-    binE_ = this->getMapBin(iX, iY, iZ1);
-    binF_ = this->getMapBin(iX1, iY, iZ1);
-    binG_ = this->getMapBin(iX, iY1, iZ1);
-    binH_ = this->getMapBin(iX1, iY1, iZ1);
+    Int_t bins[8] = {this->getMapBin(iX, iY, iZ),
+		     this->getMapBin(iX1, iY, iZ),
+		     this->getMapBin(iX, iY1, iZ),
+		     this->getMapBin(iX1, iY1, iZ),
+		     this->getMapBin(iX, iY, iZ1),
+		     this->getMapBin(iX1, iY, iZ1),
+		     this->getMapBin(iX, iY1, iZ1),
+		     this->getMapBin(iX1, iY1, iZ1)};
 
     // Retrieve the fractional bin distances
-    xFrac_ = xBinInfo.second;
-    yFrac_ = yBinInfo.second;
-    zFrac_ = zBinInfo.second;
-
-    // Set the complimentary fractional bin distances
-    xFrac1_ = 1.0 - xFrac_;
-    yFrac1_ = 1.0 - yFrac_;
-    zFrac1_ = 1.0 - zFrac_;
+    Float_t frac[3] = {xBinInfo.second, yBinInfo.second, zBinInfo.second};
 
     // Finally get the magnetic field components using trilinear interpolation
     // and scale with the appropriate multiplication factor (default = 1.0)
-    B[0] = this->BInterCalc(ShipBFieldMap::xAxis)*scale_*BxSign;
-    B[1] = this->BInterCalc(ShipBFieldMap::yAxis)*scale_;
-    B[2] = this->BInterCalc(ShipBFieldMap::zAxis)*scale_;
+    Float_t BField[3];
+    this->BInterCalc(bins, frac, BField);
+    Float_t theScale = scale_*fieldUnit_;
+    B[0] = BField[0]*theScale*BxSign;
+    B[1] = BField[1]*theScale;
+    B[2] = BField[2]*theScale;
 
 }
 
@@ -202,7 +239,11 @@ void ShipBFieldMap::initialise()
     
     if (initialised_ == kFALSE) {
 	
-	if (isCopy_ == kFALSE) {this->readMapFile();}
+	if (isCopy_ == kFALSE) {
+	    this->readMapFile();
+	    // Maps read into memory are already converted to kGauss
+	    if (!mappedFile_ && !fieldMap_->empty()) {mapData_ = fieldMap_->data();}
+	}
 
 	// Set the global co-ordinate translation and rotation info
 	if (fabs(phi_) > 1e-6 || fabs(theta_) > 1e-6 || fabs(psi_) > 1e-6) {
@@ -236,6 +277,10 @@ void ShipBFieldMap::readMapFile()
 
 	this->readRootFile();
 
+    } else if (mapFileName_.find(".bmap") != std::string::npos) {
+
+	this->readBinaryFile();
+
     } else {
 
 	this->readTextFile();
@@ -304,7 +349,7 @@ void ShipBFieldMap::readRootFile() {
 	    nEntries = 0;
 	}
 
-	fieldMap_->reserve(nEntries);
+	fieldMap_->reserve(3*nEntries);
 
 	for (Int_t i = 0; i < nEntries; i++) {
 
@@ -317,9 +362,9 @@ void ShipBFieldMap::readRootFile() {
 	    Bz *= Tesla_;
 
 	    // Store the B field 3-vector
-	    std::vector<Float_t> BVector(3);
-	    BVector[0] = Bx; BVector[1] = By; BVector[2] = Bz;
-	    fieldMap_->push_back(BVector);
+	    fieldMap_->push_back(Bx);
+	    fieldMap_->push_back(By);
+	    fieldMap_->push_back(Bz);
 
 	}
 
@@ -351,7 +396,7 @@ void ShipBFieldMap::readTextFile() {
 	
 	// The remaining lines contain Bx,By,Bz data values 
 	// in ascending z,y,x co-ord order
-	fieldMap_->reserve(N_);
+	fieldMap_->reserve(3*N_);
 
 	Float_t Bx(0.0), By(0.0), Bz(0.0);
 
@@ -366,9 +411,9 @@ void ShipBFieldMap::readTextFile() {
 	    Bz *= Tesla_;
 
 	    // Store the B field 3-vector
-	    std::vector<Float_t> BVector(3);
-	    BVector[0] = Bx; BVector[1] = By; BVector[2] = Bz;
-	    fieldMap_->push_back(BVector);
+	    fieldMap_->push_back(Bx);
+	    fieldMap_->push_back(By);
+	    fieldMap_->push_back(Bz);
 	    
 	}
 
@@ -378,7 +423,56 @@ void ShipBFieldMap::readTextFile() {
 
 }
 
-Bool_t ShipBFieldMap::insideRange(Float_t x, Float_t y, Float_t z)
+void ShipBFieldMap::readBinaryFile() {
+
+    int fd = open(mapFileName_.c_str(), O_RDONLY);
+    if (fd < 0) {
+	std::cout<<"ShipBFieldMap: could not find the file "<<mapFileName_<<std::endl;
+	return;
+    }
+
+    struct stat fileInfo;
+    BinaryMapHeader header;
+    if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size < (off_t) sizeof(header) ||
+	pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) ||
+	memcmp(header.magic, binaryMapMagic, sizeof(header.magic)) != 0 ||
+	header.version != binaryMapVersion || header.nComponents != 3) {
+	std::cout<<"ShipBFieldMap: "<<mapFileName_<<" is not a binary field map"<<std::endl;
+	close(fd);
+	return;
+    }
+
+    xMin_ = header.range[0]; xMax_ = header.range[1]; dx_ = header.range[2];
+    yMin_ = header.range[3]; yMax_ = header.range[4]; dy_ = header.range[5];
+    zMin_ = header.range[6]; zMax_ = header.range[7]; dz_ = header.range[8];
+
+    this->setLimits();
+
+    size_t expected = sizeof(header) + 3*sizeof(Float_t)*header.nBins;
+    if (header.nBins != N_ || (size_t) fileInfo.st_size < expected) {
+	std::cout<<"Expected "<<N_<<" field map entries but found "<<header.nBins<<std::endl;
+	close(fd);
+	return;
+    }
+
+    // Map the file read-only. Pages are only loaded when the field is evaluated
+    // there, and are shared with all other processes using the same map
+    void* addr = mmap(0, expected, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+	std::cout<<"ShipBFieldMap: could not memory-map "<<mapFileName_<<std::endl;
+	return;
+    }
+
+    mappedFile_ = addr;
+    mappedSize_ = expected;
+    mapData_ = reinterpret_cast<const Float_t*>(static_cast<const char*>(addr) + sizeof(header));
+    // Binary maps store the field in Tesla
+    fieldUnit_ = Tesla_;
+
+}
+
+Bool_t ShipBFieldMap::insideRange(Float_t x, Float_t y, Float_t z) const
 {
 
     Bool_t inside(kFALSE);
@@ -427,7 +521,7 @@ void ShipBFieldMap::setLimits() {
 }
 
 
-ShipBFieldMap::binPair ShipBFieldMap::getBinInfo(Float_t u, ShipBFieldMap::CoordAxis theAxis)
+ShipBFieldMap::binPair ShipBFieldMap::getBinInfo(Float_t u, ShipBFieldMap::CoordAxis theAxis) const
 {
 
     Float_t du(0.0), uMin(0.0), Nu(0);
@@ -466,7 +560,7 @@ ShipBFieldMap::binPair ShipBFieldMap::getBinInfo(Float_t u, ShipBFieldMap::Coord
 
 }
 
-Int_t ShipBFieldMap::getMapBin(Int_t iX, Int_t iY, Int_t iZ)
+Int_t ShipBFieldMap::getMapBin(Int_t iX, Int_t iY, Int_t iZ) const
 {
 
     // Get the index of the map entry corresponding to the x,y,z bins.
@@ -483,48 +577,46 @@ Int_t ShipBFieldMap::getMapBin(Int_t iX, Int_t iY, Int_t iZ)
 
 }
 
-Float_t ShipBFieldMap::BInterCalc(CoordAxis theAxis)
+void ShipBFieldMap::BInterCalc(const Int_t* bins, const Float_t* frac, Float_t* BField) const
 {
 
-    // Find the magnetic field component along theAxis using trilinear 
-    // interpolation based on the current position and neighbouring bins
-    Float_t result(0.0);
+    // Find the magnetic field components using trilinear interpolation
+    // based on the given position fractions and neighbouring bins. The eight
+    // corners are read once and all three components are interpolated
+    // together, which the compiler can vectorise
+    BField[0] = 0.0; BField[1] = 0.0; BField[2] = 0.0;
 
-    Int_t iAxis(0);
+    if (!mapData_) {return;}
 
-    if (theAxis == CoordAxis::yAxis) {
-	iAxis = 1;
-    } else if (theAxis == CoordAxis::zAxis) {
-	iAxis = 2;
-    }
+    // The fractional and complimentary fractional bin distances
+    const Float_t xFrac = frac[0], yFrac = frac[1], zFrac = frac[2];
+    const Float_t xFrac1 = 1.0 - xFrac, yFrac1 = 1.0 - yFrac, zFrac1 = 1.0 - zFrac;
 
-    if (fieldMap_) {
+    const Float_t* map = mapData_;
+    const Float_t* A = map + 3*bins[0];
+    const Float_t* B = map + 3*bins[1];
+    const Float_t* C = map + 3*bins[2];
+    const Float_t* D = map + 3*bins[3];
+    const Float_t* E = map + 3*bins[4];
+    const Float_t* F = map + 3*bins[5];
+    const Float_t* G = map + 3*bins[6];
+    const Float_t* H = map + 3*bins[7];
 
-	// Get the field component values for the neighbouring bins
-	Float_t A = (*fieldMap_)[binA_][iAxis];
-	Float_t B = (*fieldMap_)[binB_][iAxis];
-	Float_t C = (*fieldMap_)[binC_][iAxis];
-	Float_t D = (*fieldMap_)[binD_][iAxis];
-	Float_t E = (*fieldMap_)[binE_][iAxis];
-	Float_t F = (*fieldMap_)[binF_][iAxis];
-	Float_t G = (*fieldMap_)[binG_][iAxis];
-	Float_t H = (*fieldMap_)[binH_][iAxis];
+    for (Int_t i = 0; i < 3; i++) {
 
 	// Perform linear interpolation along x
-	Float_t F00 = A*xFrac1_ + B*xFrac_;
-	Float_t F10 = C*xFrac1_ + D*xFrac_;
-	Float_t F01 = E*xFrac1_ + F*xFrac_;
-	Float_t F11 = G*xFrac1_ + H*xFrac_;
+	Float_t F00 = A[i]*xFrac1 + B[i]*xFrac;
+	Float_t F10 = C[i]*xFrac1 + D[i]*xFrac;
+	Float_t F01 = E[i]*xFrac1 + F[i]*xFrac;
+	Float_t F11 = G[i]*xFrac1 + H[i]*xFrac;
 
 	// Linear interpolation along y
-	Float_t F0 = F00*yFrac1_ + F10*yFrac_;
-	Float_t F1 = F01*yFrac1_ + F11*yFrac_;
+	Float_t F0 = F00*yFrac1 + F10*yFrac;
+	Float_t F1 = F01*yFrac1 + F11*yFrac;
 
 	// Linear interpolation along z
-	result = F0*zFrac1_ + F1*zFrac_;
+	BField[i] = F0*zFrac1 + F1*zFrac;
 
     }
 
-    return result;
-
 }
@@ -9,6 +9,7 @@
 #include "TGeoMatrix.h"
 #include "TVirtualMagField.h"
 
+#include <cstddef>
 #include <string>
 #include <utility>
 #include <vector>
@@ -21,7 +22,9 @@ class ShipBFieldMap : public TVirtualMagField
     //! Constructor
     /*!
       \param [in] label A descriptive name/title/label for this field
-      \param [in] mapFileName The name of the field map file (distances in cm, fields in Tesla)
+      \param [in] mapFileName The name of the field map file (distances in cm, fields in Tesla).
+      ROOT (.root) and binary (.bmap) maps are supported, otherwise a text map is assumed.
+      Binary maps are memory-mapped read-only, so processes on one node share them
       \param [in] xOffset The x global co-ordinate shift to position the field map (cm)
       \param [in] yOffset The y global co-ordinate shift to position the field map (cm)
       \param [in] zOffset The z global co-ordinate shift to position the field map (cm)
@@ -65,15 +68,36 @@ class ShipBFieldMap : public TVirtualMagField
     */
     virtual void Field(const Double_t* position, Double_t* B);
 
-    //! Typedef for a vector containing a vector of floats
-    typedef std::vector< std::vector<Float_t> > floatArray;
+    //! Reentrant evaluation of the B field. It only reads the (shared) field map
+    //! and keeps all intermediate results on the stack, so the same map can be
+    //! queried concurrently from several threads
+    /*!
+      \param [in] position The x,y,z global co-ordinates of the point (cm)
+      \param [out] B The x,y,z components of the magnetic field (kGauss = 0.1 tesla)
+    */
+    void GetFieldValue(const Double_t* position, Double_t* B) const;
+
+    //! Typedef for the contiguous field map storage, with the Bx, By, Bz
+    //! components of each bin stored next to each other
+    typedef std::vector<Float_t> floatArray;
 
     //! Retrieve the field map
     /*!
-      \returns the field map
+      \returns the field map, the components of bin i are entries 3*i, 3*i+1 and 3*i+2.
+      It is empty for memory-mapped binary maps, use getFieldData() instead
     */
     floatArray* getFieldMap() const {return fieldMap_;}
 
+    //! Retrieve the field map values, whether read into memory or memory-mapped
+    /*!
+      \returns the 3*GetNBins() field components, in Tesla for binary maps and
+      in kGauss otherwise (see getFieldUnit())
+    */
+    const Float_t* getFieldData() const {return mapData_;}
+
+    //! Get the factor converting the stored field values to kGauss
+    Float_t getFieldUnit() const {return fieldUnit_;}
+
     //! Set the x global co-ordinate shift
     /*!
       \param [in] xValue The value of the x global co-ordinate shift (cm)
@@ -280,7 +304,7 @@ class ShipBFieldMap : public TVirtualMagField
     Bool_t IsACopy() const {return isCopy_;}
 
     //! ClassDef for ROOT
-    ClassDef(ShipBFieldMap,1);
+    ClassDef(ShipBFieldMap,2);
 
 
  protected:
@@ -308,6 +332,9 @@ class ShipBFieldMap : public TVirtualMagField
     //! Process the text file containing the field map data
     void readTextFile();
 
+    //! Memory-map the binary file containing the field map data
+    void readBinaryFile();
+
     // ! Set the coordinate limits from information stored in the datafile
     void setLimits();
 
@@ -318,7 +345,7 @@ class ShipBFieldMap : public TVirtualMagField
       \param [in] z The z co-ordinate of the point (cm)
       \returns true/false if the point is inside the field map range
     */
-    Bool_t insideRange(Float_t x, Float_t y, Float_t z);
+    Bool_t insideRange(Float_t x, Float_t y, Float_t z) const;
 
     //! Typedef for an int-double pair
     typedef std::pair<Int_t, Float_t> binPair;
@@ -329,7 +356,7 @@ class ShipBFieldMap : public TVirtualMagField
       \param [in] theAxis The co-ordinate axis (CoordAxis enumeration for x, y or z)
       \returns the bin number and fractional distance from the leftmost bin edge as a pair
     */
-    binPair getBinInfo(Float_t x, CoordAxis theAxis);
+    binPair getBinInfo(Float_t x, CoordAxis theAxis) const;
 
     //! Find the vector entry of the field map data given the bins iX, iY and iZ
     /*!
@@ -338,17 +365,17 @@ class ShipBFieldMap : public TVirtualMagField
       \param [in] iZ The bin along the z axis
       \returns the index entry for the field map data vector
     */
-    Int_t getMapBin(Int_t iX, Int_t iY, Int_t iZ);
+    Int_t getMapBin(Int_t iX, Int_t iY, Int_t iZ) const;
 
-    //! Calculate the magnetic field component using trilinear interpolation.
-    //! This function uses the various "binX" integers and "uFrac" variables
+    //! Calculate the three magnetic field components in one trilinear interpolation pass
     /*!
-      \param [in] theAxis The co-ordinate axis (CoordAxis enumeration for x, y or z)
-      \returns the magnetic field component for the given axis
+      \param [in] bins The map entries of the eight neighbouring bins A to H
+      \param [in] frac The fractional bin distances along x, y and z
+      \param [out] BField The interpolated Bx, By and Bz components
     */
-    Float_t BInterCalc(CoordAxis theAxis);
+    void BInterCalc(const Int_t* bins, const Float_t* frac, Float_t* BField) const;
 
-    //! Store the field map information as a vector of 3 floats.
+    //! Store the field map information contiguously, 3 floats per bin.
     //! Map data ordering is given by first incrementing z, then y, then x
     floatArray* fieldMap_;
 
@@ -439,47 +466,16 @@ class ShipBFieldMap : public TVirtualMagField
     //! Double converting Tesla to kiloGauss (for VMC/FairRoot B field units)
     Float_t Tesla_;
 
-    //! Bin A for the trilinear interpolation
-    Int_t binA_;
-
-    //! Bin B for the trilinear interpolation
-    Int_t binB_;
-
-    //! Bin C for the trilinear interpolation
-    Int_t binC_;
-
-    //! Bin D for the trilinear interpolation
-    Int_t binD_;
-
-    //! Bin E for the trilinear interpolation
-    Int_t binE_;
-
-    //! Bin F for the trilinear interpolation
-    Int_t binF_;
-
-    //! Bin G for the trilinear interpolation
-    Int_t binG_;
-
-    //! Bin H for the trilinear interpolation
-    Int_t binH_;
-
-    //! Fractional bin distance along x
-    Float_t xFrac_;
-
-    //! Fractional bin distance along y
-    Float_t yFrac_;
-
-    //! Fractional bin distance along z
-    Float_t zFrac_;
-
-    //! Complimentary fractional bin distance along x
-    Float_t xFrac1_;
+    //! The field map values used for the interpolation, either the fieldMap_
+    //! data or the memory-mapped binary map
+    const Float_t* mapData_; //!
 
-    //! Complimentary fractional bin distance along y
-    Float_t yFrac1_;
+    //! Factor converting the mapData_ values to kGauss
+    Float_t fieldUnit_; //!
 
-    //! Complimentary fractional bin distance along z
-    Float_t zFrac1_;
+    //! Start and length of the memory-mapped binary file
+    void* mappedFile_; //!
+    size_t mappedSize_; //!
 
 };
 
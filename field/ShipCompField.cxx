@@ -39,6 +39,11 @@ ShipCompField::~ShipCompField()
 }
 
 void ShipCompField::Field(const Double_t* position, Double_t* B)
+{
+    this->GetFieldValue(position, B);
+}
+
+void ShipCompField::GetFieldValue(const Double_t* position, Double_t* B) const
 {
 
     // Loop over the fields and do a simple linear superposition
@@ -49,6 +49,15 @@ class ShipCompField: public TVirtualMagField
     */
     virtual void Field(const Double_t* position, Double_t* B);
 
+    //! Reentrant version of Field: ShipBFieldMap::Field forwards to the read-only
+    //! ShipBFieldMap::GetFieldValue, so one composite field can be shared
+    //! between threads as long as its other components are stateless
+    /*!
+      \param [in] position The x,y,z global co-ordinates of the point
+      \param [out] B The x,y,z components of the magnetic field
+    */
+    void GetFieldValue(const Double_t* position, Double_t* B) const;
+
     //! Get the number of fields in the composite
     /*!
       \returns the number of fields used in the composite
@@ -0,0 +1,112 @@
+#!/bin/python
+
+# Python script to convert a B field map used by ShipBFieldMap, either a ROOT
+# file (Range and Data TTrees, as made by convertMap.py) or a text map file
+# (header line "label xMin xMax dx yMin yMax dy zMin zMax dz", a line of column
+# labels, then "Bx By Bz" lines), into the binary .bmap format. ShipBFieldMap
+# memory-maps .bmap files read-only, so they load instantly and all processes
+# on one node share the same physical pages.
+#
+# Binary format (little-endian): a 64 byte header
+#   char magic[8] = "SHIPBMAP", uint32 version = 1, uint32 nComponents = 3,
+#   float xMin, xMax, dx, yMin, yMax, dy, zMin, zMax, dz (cm), uint32 padding,
+#   int64 nBins
+# followed by the float Bx, By, Bz values (Tesla) of each bin, using the bin
+# ordering (iX*Ny + iY)*Nz + iZ, i.e. ascending z, then y, then x.
+
+from __future__ import print_function
+import array
+import struct
+import sys
+
+headerFormat = '<8sII9fIq'
+mapVersion = 1
+
+
+def run(inFileName = 'BFieldTest.root', binFileName = 'BFieldTest.bmap'):
+
+    if inFileName.endswith('.root'):
+        rangeInfo, field = readRootMap(inFileName)
+    else:
+        rangeInfo, field = readTextMap(inFileName)
+
+    writeBinaryMap(binFileName, rangeInfo, field)
+
+
+def nBins(rangeInfo):
+
+    # Same bin counting as ShipBFieldMap::setLimits
+    N = 1
+    for (uMin, uMax, du) in [rangeInfo[0:3], rangeInfo[3:6], rangeInfo[6:9]]:
+        if du > 0.0:
+            N *= int(((uMax - uMin)/du) + 1.5)
+        else:
+            N = 0
+    return N
+
+
+def readRootMap(inFileName):
+
+    import ROOT
+
+    print('Reading ROOT field map {0}'.format(inFileName))
+    theFile = ROOT.TFile.Open(inFileName)
+    rTree = theFile.Get('Range')
+    rTree.GetEntry(0)
+    rangeInfo = [rTree.xMin, rTree.xMax, rTree.dx, rTree.yMin, rTree.yMax, rTree.dy,
+                 rTree.zMin, rTree.zMax, rTree.dz]
+
+    dTree = theFile.Get('Data')
+    dTree.SetBranchStatus('*', 0)
+    for b in ['Bx', 'By', 'Bz']:
+        dTree.SetBranchStatus(b, 1)
+
+    field = array.array('f')
+    for entry in dTree:
+        field.extend([entry.Bx, entry.By, entry.Bz])
+
+    theFile.Close()
+    return rangeInfo, field
+
+
+def readTextMap(inFileName):
+
+    print('Reading text field map {0}'.format(inFileName))
+    field = array.array('f')
+    with open(inFileName, 'r') as f:
+
+        # First line: label and co-ordinate ranges, second line: column labels
+        rangeInfo = [float(x) for x in f.readline().split()[1:10]]
+        f.readline()
+
+        for line in f:
+            sLine = line.split()
+            if len(sLine) >= 3:
+                field.extend([float(sLine[0]), float(sLine[1]), float(sLine[2])])
+
+    return rangeInfo, field
+
+
+def writeBinaryMap(binFileName, rangeInfo, field):
+
+    N = nBins(rangeInfo)
+    if len(field) != 3*N:
+        print('Expected {0} field map entries but found {1}'.format(N, len(field)//3))
+        sys.exit(1)
+
+    if sys.byteorder != 'little':
+        field.byteswap()
+
+    print('Writing binary field map {0} with {1} bins'.format(binFileName, N))
+    with open(binFileName, 'wb') as f:
+        f.write(struct.pack(headerFormat, b'SHIPBMAP', mapVersion, 3, *(rangeInfo + [0, N])))
+        field.tofile(f)
+
+
+if __name__ == "__main__":
+
+    if len(sys.argv) != 3:
+        print('Usage: python convertMapToBinary.py inputMap.root|inputMap.txt outputMap.bmap')
+        sys.exit(1)
+
+    run(sys.argv[1], sys.argv[2])
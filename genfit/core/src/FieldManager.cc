@@ -20,6 +20,7 @@
 
 #include <iostream>
 #include <math.h>
+#include <vector>
 
 namespace genfit {
 
@@ -29,60 +30,104 @@ AbsBField* FieldManager::field_ = NULL;
 #ifdef CACHE
 bool FieldManager::useCache_ = false;
 unsigned int FieldManager::n_buckets_ = 8;
-fieldCache* FieldManager::cache_ = NULL;
+std::atomic<unsigned int> FieldManager::cacheGeneration_(0);
+
+namespace {
+
+  // Cache buckets and ring positions of one thread.
+  struct threadFieldCache {
+    threadFieldCache() : generation(0), lastRead(0), lastWritten(0) {}
+    std::vector<fieldCache> buckets;
+    unsigned int generation;
+    unsigned int lastRead;
+    unsigned int lastWritten;
+  };
+
+  thread_local threadFieldCache tCache;
+
+  const double epsilon = 0.001;
+
+}
 #endif
 
 //#define DEBUG
 
 #ifdef CACHE
+bool FieldManager::readCache(const double* pos, double* B) const {
+
+  // cache code copied from http://en.wikibooks.org/wiki/Optimizing_C%2B%2B/General_optimization_techniques/Memoization
+  threadFieldCache& c = tCache;
+
+  if (c.generation != cacheGeneration_ || c.buckets.size() != n_buckets_) {
+    fieldCache empty;
+    // Should be safe to initialize with values in Andromeda
+    empty.posX = empty.posY = empty.posZ = 2.4e24 / sqrt(3);
+    empty.Bx = empty.By = empty.Bz = 1e30;
+    c.buckets.assign(n_buckets_, empty);
+    c.generation = cacheGeneration_;
+    c.lastRead = c.lastWritten = 0;
+  }
+
+  #ifdef DEBUG
+  static thread_local int used = 0;
+  static thread_local int notUsed = 0;
+  #endif
+
+  unsigned int i = c.lastRead;
+  do {
+    const fieldCache& entry = c.buckets[i];
+    if (fabs(entry.posX - pos[0]) < epsilon &&
+        fabs(entry.posY - pos[1]) < epsilon &&
+        fabs(entry.posZ - pos[2]) < epsilon) {
+      B[0] = entry.Bx;
+      B[1] = entry.By;
+      B[2] = entry.Bz;
+      #ifdef DEBUG
+      ++used;
+      std::cout<<"used the cache! " << double(used)/(used + notUsed) << "\n";
+      #endif
+      return true;
+    }
+    i = (i + 1) % n_buckets_;
+  } while (i != c.lastRead);
+
+  #ifdef DEBUG
+  ++notUsed;
+  std::cout<<"did NOT use the cache! \n";
+  #endif
+  return false;
+}
+
+
+void FieldManager::writeCache(const double* pos, const double* B) const {
+  threadFieldCache& c = tCache;
+
+  c.lastRead = c.lastWritten = (c.lastWritten + 1) % n_buckets_;
+
+  fieldCache& entry = c.buckets[c.lastWritten];
+  entry.posX = pos[0];
+  entry.posY = pos[1];
+  entry.posZ = pos[2];
+  entry.Bx = B[0];
+  entry.By = B[1];
+  entry.Bz = B[2];
+}
+
+
 void FieldManager::getFieldVal(const double& posX, const double& posY, const double& posZ, double& Bx, double& By, double& Bz){
   checkInitialized();
 
   if (useCache_) {
 
-    // cache code copied from http://en.wikibooks.org/wiki/Optimizing_C%2B%2B/General_optimization_techniques/Memoization
-    static int last_read_i = 0;
-    static int last_written_i = 0;
-    int i = last_read_i;
-
-    static const double epsilon = 0.001;
-
-    #ifdef DEBUG
-    static int used = 0;
-    static int notUsed = 0;
-    #endif
-
-    do {
-      if (fabs(cache_[i].posX - posX) < epsilon &&
-          fabs(cache_[i].posY - posY) < epsilon &&
-          fabs(cache_[i].posZ - posZ) < epsilon) {
-        Bx = cache_[i].Bx;
-        By = cache_[i].By;
-        Bz = cache_[i].Bz;
-        #ifdef DEBUG
-        ++used;
-        std::cout<<"used the cache! " << double(used)/(used + notUsed) << "\n";
-        #endif
-        return;
-      }
-      i = (i + 1) % n_buckets_;
-    } while (i != last_read_i);
-
-    last_read_i = last_written_i = (last_written_i + 1) % n_buckets_;
-
-    cache_[last_written_i].posX = posX;
-    cache_[last_written_i].posY = posY;
-    cache_[last_written_i].posZ = posZ;
-
-    field_->get(posX, posY, posZ, cache_[last_written_i].Bx, cache_[last_written_i].By, cache_[last_written_i].Bz);
-
-    Bx = cache_[last_written_i].Bx;
-    By = cache_[last_written_i].By;
-    Bz = cache_[last_written_i].Bz;
-    #ifdef DEBUG
-    ++notUsed;
-    std::cout<<"did NOT use the cache! \n";
-    #endif
+    const double pos[3] = {posX, posY, posZ};
+    double B[3];
+    if (!readCache(pos, B)) {
+      field_->get(posX, posY, posZ, B[0], B[1], B[2]);
+      writeCache(pos, B);
+    }
+    Bx = B[0];
+    By = B[1];
+    Bz = B[2];
     return;
 
   }
@@ -96,14 +141,8 @@ void FieldManager::useCache(bool opt, unsigned int nBuckets) {
   useCache_ = opt;
   n_buckets_ = nBuckets;
 
-  if (useCache_) {
-    cache_ = new fieldCache[n_buckets_];
-    for (size_t i = 0; i < n_buckets_; ++i) {
-      // Should be safe to initialize with values in Andromeda
-      cache_[i].posX = cache_[i].posY = cache_[i].posZ = 2.4e24 / sqrt(3);
-      cache_[i].Bx = cache_[i].By = cache_[i].Bz = 1e30;
-    }
-  }
+  // Every thread rebuilds its buckets on its next lookup
+  ++cacheGeneration_;
 }
 #endif
 
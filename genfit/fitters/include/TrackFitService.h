@@ -0,0 +1,93 @@
+/*
+fit many tracks concurrently, each worker thread with its own fitter,
+TGeo navigator and MaterialEffects state
+*/
+/** @addtogroup genfit
+ * @{
+ */
+
+#ifndef genfit_TrackFitService_h
+#define genfit_TrackFitService_h
+
+#include "AbsFitter.h"
+
+#include <vector>
+
+class TGeoNavigator;
+
+
+namespace genfit {
+
+class Track;
+
+/**
+ * @brief Fits a list of tracks on a pool of threads.
+ *
+ * Every worker creates its own fitter, adds a navigator to gGeoManager and
+ * uses its own MaterialEffects::useThreadInstance(), while the field
+ * (FieldManager) and the material interface are shared. The field therefore
+ * has to be reentrant, e.g. FairShipFields with a ShipCompField or ConstField.
+ * Tracks are handed out one by one, so expensive and cheap tracks balance out.
+ */
+class TrackFitService {
+
+ public:
+
+  //! Creates a new fitter for a worker thread
+  typedef AbsFitter* (*FitterFactory)();
+
+  /**
+   * @brief Per-thread state for fitting or extrapolating in a worker thread.
+   *
+   * Create one at the start of the thread: it adds a TGeo navigator if the
+   * thread has none and switches to MaterialEffects::useThreadInstance().
+   * Both are released again when it goes out of scope.
+   */
+  class ThreadContext {
+   public:
+    ThreadContext();
+    ~ThreadContext();
+    ThreadContext(const ThreadContext&) = delete;
+    ThreadContext& operator=(const ThreadContext&) = delete;
+   private:
+    TGeoNavigator* nav_;
+  };
+
+  //! Call in the main thread before starting nThreads workers that use a ThreadContext
+  static void prepareThreads(unsigned int nThreads);
+
+  //! nThreads = 0 uses one thread per core
+  TrackFitService(unsigned int nThreads = 0);
+  ~TrackFitService() {;}
+
+  void setNThreads(unsigned int nThreads);
+  unsigned int getNThreads() const {return nThreads_;}
+
+  //! Iterations of the default KalmanFitter
+  void setMaxIterations(unsigned int n) {maxIterations_ = n;}
+  //! Use another fitter than the default KalmanFitter
+  void setFitterFactory(FitterFactory factory) {factory_ = factory;}
+  void setResortHits(bool opt = true) {resortHits_ = opt;}
+
+  /**
+   * @brief Fit all tracks with all their reps, like AbsFitter::processTrack.
+   *
+   * Returns the number of tracks whose fit threw an exception.
+   */
+  unsigned int fitTracks(const std::vector<genfit::Track*>& tracks);
+
+ private:
+
+  AbsFitter* makeFitter() const;
+
+  unsigned int nThreads_;
+  unsigned int maxIterations_;
+  bool resortHits_;
+  FitterFactory factory_; //!
+
+};
+
+} /* End of namespace genfit */
+/** @} */
+
+#endif // genfit_TrackFitService_h
@@ -0,0 +1,117 @@
+/*
+fit many tracks concurrently, each worker thread with its own fitter,
+TGeo navigator and MaterialEffects state
+*/
+#include "TrackFitService.h"
+#include "KalmanFitter.h"
+#include "MaterialEffects.h"
+#include "Track.h"
+
+#include <TDatabasePDG.h>
+#include <TGeoManager.h>
+#include <TROOT.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+namespace genfit {
+
+TrackFitService::TrackFitService(unsigned int nThreads)
+  : nThreads_(0), maxIterations_(50), resortHits_(true), factory_(nullptr)
+{
+  setNThreads(nThreads);
+}
+
+
+void TrackFitService::setNThreads(unsigned int nThreads) {
+  nThreads_ = nThreads > 0 ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+TrackFitService::ThreadContext::ThreadContext() : nav_(nullptr) {
+  if (gGeoManager != nullptr && gGeoManager->GetCurrentNavigator() == nullptr)
+    nav_ = gGeoManager->AddNavigator();
+  MaterialEffects::useThreadInstance();
+}
+
+
+TrackFitService::ThreadContext::~ThreadContext() {
+  MaterialEffects::releaseThreadInstance();
+  if (nav_ != nullptr)
+    gGeoManager->RemoveNavigator(nav_);
+}
+
+
+void TrackFitService::prepareThreads(unsigned int nThreads) {
+  ROOT::EnableThreadSafety();
+  if (gGeoManager != nullptr && gGeoManager->GetMaxThreads() < int(nThreads))
+    gGeoManager->SetMaxThreads(nThreads);
+  // fill the particle table before the workers look up masses and charges
+  TDatabasePDG::Instance()->GetParticle(13);
+}
+
+
+AbsFitter* TrackFitService::makeFitter() const {
+  if (factory_ != nullptr)
+    return factory_();
+  KalmanFitter* fitter = new KalmanFitter();
+  fitter->setMaxIterations(maxIterations_);
+  return fitter;
+}
+
+
+unsigned int TrackFitService::fitTracks(const std::vector<genfit::Track*>& tracks) {
+
+  if (tracks.empty())
+    return 0;
+
+  unsigned int nThreads = std::min<size_t>(nThreads_, tracks.size());
+
+  // Single threaded: no need for private navigators and material effects
+  if (nThreads == 1) {
+    std::unique_ptr<AbsFitter> fitter(makeFitter());
+    unsigned int nFailed = 0;
+    for (Track* track : tracks) {
+      try {
+        fitter->processTrack(track, resortHits_);
+      }
+      catch(std::exception& e) {
+        std::cerr << "TrackFitService: fit failed " << e.what() << std::endl;
+        ++nFailed;
+      }
+    }
+    return nFailed;
+  }
+
+  prepareThreads(nThreads);
+
+  std::atomic<size_t> next(0);
+  std::atomic<unsigned int> nFailed(0);
+  std::vector<std::thread> workers;
+
+  for (unsigned int w = 0; w < nThreads; ++w) {
+    workers.emplace_back([this, &tracks, &next, &nFailed]() {
+      ThreadContext context;
+
+      std::unique_ptr<AbsFitter> fitter(makeFitter());
+      for (size_t i = next++; i < tracks.size(); i = next++) {
+        try {
+          fitter->processTrack(tracks[i], resortHits_);
+        }
+        catch(std::exception& e) {
+          std::cerr << "TrackFitService: fit of track " << i << " failed " << e.what() << std::endl;
+          ++nFailed;
+        }
+      }
+    });
+  }
+  for (std::thread& worker : workers) worker.join();
+
+  return nFailed;
+}
+
+} /* End of namespace genfit */
@@ -18,6 +18,7 @@
 #pragma link C++ class genfit::AbsKalmanFitter+;
 #pragma link C++ class genfit::KalmanFitStatus;
 #pragma link C++ class genfit::KalmanFitterRefTrack+;
+#pragma link C++ class genfit::TrackFitService;
 #pragma link C++ class genfit::GFGbl+;
 #pragma link C++ class genfit::HMatrixU+;
 #pragma link C++ class genfit::HMatrixUnit+;
@@ -26,6 +26,7 @@
 
 #include "AbsBField.h"
 
+#include <atomic>
 #include <iostream>
 #include <stdexcept>
 #include <string>
@@ -77,6 +78,9 @@ class FieldManager {
   //! set the magnetic field here. Magnetic field classes must be derived from AbsBField.
   void init(AbsBField* b) {
     field_=b;
+#ifdef CACHE
+    ++cacheGeneration_;
+#endif
   }
 
   bool isInitialized() { return field_ != NULL; }
@@ -101,6 +105,7 @@ class FieldManager {
 
 #ifdef CACHE
   //! Cache last lookup positions, and use stored field values if a lookup at (almost) the same position is done.
+  //! Every thread keeps its own cache, so concurrent lookups do not interfere.
   void useCache(bool opt = true, unsigned int nBuckets = 8);
 #else
   void useCache(bool opt = true, unsigned int nBuckets = 8) {
@@ -120,18 +125,20 @@ class FieldManager {
  private:
 
   FieldManager() {}
-#ifdef CACHE
-  ~FieldManager() { delete cache_; }
-#else
   ~FieldManager() { }
-#endif
   static FieldManager* instance_;
   static AbsBField* field_;
 
 #ifdef CACHE
   static bool useCache_;
   static unsigned int n_buckets_;
-  static fieldCache* cache_;
+  //! Bumped by init() and useCache(); per-thread caches filled under an older generation are reset.
+  static std::atomic<unsigned int> cacheGeneration_;
+
+  //! Look up a single position in the calling thread's cache. Returns false if it has to be evaluated.
+  bool readCache(const double* pos, double* B) const;
+  //! Store a freshly evaluated field value in the calling thread's cache.
+  void writeCache(const double* pos, const double* B) const;
 #endif
 
 };
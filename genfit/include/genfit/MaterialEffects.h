@@ -60,9 +60,19 @@ class MaterialEffects  {
 
 public:
 
+  //! Returns the calling thread's own instance if it has one (see useThreadInstance()), the global one otherwise.
   static MaterialEffects* getInstance();
   static void destruct();
 
+  /** @brief Give the calling thread its own MaterialEffects.
+   *
+   *  It is a copy of the global instance, with the same settings and the same material interface,
+   *  so tracks can be extrapolated in several threads without sharing the per-step state.
+   */
+  static void useThreadInstance();
+  //! Delete the calling thread's own instance, getInstance() returns the global one again.
+  static void releaseThreadInstance();
+
   //! set the material interface here. Material interface classes must be derived from AbsMaterialInterface.
   void init(AbsMaterialInterface* matIfc);
   bool isInitialized() { return materialInterface_ != nullptr; }
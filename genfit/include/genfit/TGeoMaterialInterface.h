@@ -26,6 +26,10 @@
 
 #include "AbsMaterialInterface.h"
 
+#include <vector>
+
+class TGeoMaterial;
+class TGeoNavigator;
 
 namespace genfit {
 
@@ -68,9 +72,54 @@ class TGeoMaterialInterface : public AbsMaterialInterface {
 
   double findNextBoundaryAndStepStraight(double sMax);
 
+  /** @brief Cache the material of a part of the detector that is layered in z,
+   * e.g. absorber walls and detector planes, so that tracks inside it are
+   * followed without the TGeo navigator.
+   *
+   * The box [xMin, xMax]*[yMin, yMax]*[zMin, zMax] (cm) is traced along z with
+   * a private navigator on nProbe*nProbe lines. The slab faces are the TGeo
+   * boundaries found on these lines, adjacent volumes of the same material are
+   * merged. The cache is only kept if all lines cross the same materials with
+   * faces agreeing to 1 micron, so tracks inside the box see the material
+   * budget of the TGeo path. Otherwise the navigator stays in charge.
+   * Returns whether the cache is used.
+   */
+  bool buildSlabCache(double xMin, double xMax, double yMin, double yMax,
+                      double zMin, double zMax, int nProbe = 5);
+
+  //! Drop the slab cache and go back to navigating the geometry everywhere.
+  void clearSlabCache();
+
+  bool hasSlabCache() const { return !slabMaterials_.empty(); }
+  unsigned int getNSlabs() const { return slabMaterials_.size(); }
+  //! Thickness of the cached slabs along z in radiation lengths
+  double getSlabBudget() const;
+
   ClassDef(TGeoMaterialInterface, 1);
 
  private:
+
+  //! Index of the slab containing the point, -1 outside the slab box.
+  int slab(double x, double y, double z) const;
+
+  //! Straight line distance from pos along dir to the next slab face or box wall, at most sMax.
+  double slabDistance(const double* pos, const double* dir, int iSlab, double sMax) const;
+
+  //! Shorten the navigator's step and safety so that entering the slab box counts as a boundary.
+  void limitToSlabBox(double& safety, double& step) const;
+
+  //! Materials and their faces along z at (x, y), false if the line leaves the geometry.
+  bool traceSlabs(TGeoNavigator& nav, double x, double y, double zMin, double zMax,
+                  std::vector<double>& faces, std::vector<TGeoMaterial*>& materials) const;
+
+  double findNextBoundaryInSlabs(const RKTrackRep* rep,
+                                 const M1x7& state7,
+                                 double sMax,
+                                 bool varField);
+
+  std::vector<double> slabZ_; //! slab i spans [slabZ_[i], slabZ_[i+1])
+  std::vector<MaterialProperties> slabMaterials_; //!
+  double slabBox_[4]; //! xMin, xMax, yMin, yMax
 };
 
 } /* End of namespace genfit */
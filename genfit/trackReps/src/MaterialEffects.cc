@@ -37,6 +37,10 @@ namespace genfit {
 
 MaterialEffects* MaterialEffects::instance_ = nullptr;
 
+namespace {
+  thread_local MaterialEffects* threadInstance = nullptr;
+}
+
 
 MaterialEffects::MaterialEffects():
   noEffects_(false),
@@ -71,10 +75,27 @@ MaterialEffects::~MaterialEffects()
 
 MaterialEffects* MaterialEffects::getInstance()
 {
+  if (threadInstance != nullptr) return threadInstance;
   if (instance_ == nullptr) instance_ = new MaterialEffects();
   return instance_;
 }
 
+void MaterialEffects::useThreadInstance()
+{
+  if (threadInstance != nullptr) return;
+  if (instance_ == nullptr) instance_ = new MaterialEffects();
+  threadInstance = new MaterialEffects(*instance_);
+}
+
+void MaterialEffects::releaseThreadInstance()
+{
+  if (threadInstance == nullptr) return;
+  // the material interface belongs to the global instance
+  threadInstance->materialInterface_ = nullptr;
+  delete threadInstance;
+  threadInstance = nullptr;
+}
+
 void MaterialEffects::destruct()
 {
   if (instance_ != nullptr) {
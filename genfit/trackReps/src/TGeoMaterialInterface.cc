@@ -23,8 +23,11 @@
 #include <TGeoMedium.h>
 #include <TGeoMaterial.h>
 #include <TGeoManager.h>
+#include <TGeoNavigator.h>
 #include <assert.h>
 #include <math.h>
+#include <algorithm>
+#include <iostream>
 
 static const bool debug = false;
 //static const bool debug = true;
@@ -34,6 +37,26 @@ namespace genfit {
 double MeanExcEnergy_get(int Z);
 double MeanExcEnergy_get(TGeoMaterial*);
 
+namespace {
+
+  // Where the current track of this thread is, when it is inside a slab cache
+  struct slabCursor {
+    slabCursor() : owner(NULL), slab(-1) {}
+    const TGeoMaterialInterface* owner;
+    int slab;
+    double pos[3];
+    double dir[3];
+  };
+
+  thread_local slabCursor tCursor;
+
+  // Distance by which findNextBoundaryAndStepStraight moves past a slab face
+  const double slabNudge = 1.E-4; // cm
+  // Allowed difference of the faces seen by the probe lines of buildSlabCache
+  const double slabTolerance = 1.E-4; // cm
+
+}
+
 
 bool
 TGeoMaterialInterface::initTrack(double posX, double posY, double posZ,
@@ -44,8 +67,23 @@ TGeoMaterialInterface::initTrack(double posX, double posY, double posZ,
   std::cout << "Dir    "; TVector3(dirX, dirY, dirZ).Print();
   #endif
 
+  bool wasInSlabs = (tCursor.owner == this && tCursor.slab >= 0);
+
+  if (hasSlabCache()) {
+    int iSlab = slab(posX, posY, posZ);
+    if (iSlab >= 0) {
+      bool result = !wasInSlabs || iSlab != tCursor.slab;
+      tCursor.owner = this;
+      tCursor.slab = iSlab;
+      tCursor.pos[0] = posX; tCursor.pos[1] = posY; tCursor.pos[2] = posZ;
+      tCursor.dir[0] = dirX; tCursor.dir[1] = dirY; tCursor.dir[2] = dirZ;
+      return result;
+    }
+    tCursor.slab = -1;
+  }
+
   // Move to the new point.
-  bool result = !gGeoManager->IsSameLocation(posX, posY, posZ, kTRUE);
+  bool result = !gGeoManager->IsSameLocation(posX, posY, posZ, kTRUE) || wasInSlabs;
   // Set the intended direction.
   gGeoManager->SetCurrentDirection(dirX, dirY, dirZ);
   return result;
@@ -59,6 +97,11 @@ TGeoMaterialInterface::getMaterialParameters(double& density,
                                                double& radiationLength,
                                                double& mEE){
 
+  if (tCursor.owner == this && tCursor.slab >= 0) {
+    slabMaterials_[tCursor.slab].getMaterialProperties(density, Z, A, radiationLength, mEE);
+    return;
+  }
+
   TGeoMaterial* mat = gGeoManager->GetCurrentVolume()->GetMedium()->GetMaterial();
 
   density         = mat->GetDensity();
@@ -73,6 +116,11 @@ TGeoMaterialInterface::getMaterialParameters(double& density,
 void
 TGeoMaterialInterface::getMaterialParameters(MaterialProperties& parameters) {
 
+  if (tCursor.owner == this && tCursor.slab >= 0) {
+    parameters = slabMaterials_[tCursor.slab];
+    return;
+  }
+
   TGeoMaterial* mat = gGeoManager->GetCurrentVolume()->GetMedium()->GetMaterial();
 
   parameters.setMaterialProperties(mat->GetDensity(),
@@ -90,6 +138,9 @@ TGeoMaterialInterface::findNextBoundary(const RKTrackRep* rep,
                                           double sMax, // signed
                                           bool varField)
 {
+  if (tCursor.owner == this && tCursor.slab >= 0)
+    return findNextBoundaryInSlabs(rep, stateOrig, sMax, varField);
+
   const double delta(1.E-2); // cm, distance limit beneath which straight-line steps are taken.
   const double epsilon(1.E-1); // cm, allowed upper bound on arch
 			       // deviation from straight line
@@ -109,6 +160,7 @@ TGeoMaterialInterface::findNextBoundary(const RKTrackRep* rep,
   gGeoManager->FindNextBoundary(fabs(sMax) - s);
   double safety = gGeoManager->GetSafeDistance();
   double slDist = gGeoManager->GetStep();
+  limitToSlabBox(safety, slDist);
   double step = slDist;
 
   while (1) {
@@ -163,6 +215,7 @@ TGeoMaterialInterface::findNextBoundary(const RKTrackRep* rep,
       step = std::max(step / 2, safety);
     } else {
       gGeoManager->PushPoint();
+      slabCursor cursor = tCursor;
       bool volChanged = initTrack(state7[0], state7[1], state7[2],
 				  stepSign*state7[3], stepSign*state7[4],
 				  stepSign*state7[5]);
@@ -170,6 +223,7 @@ TGeoMaterialInterface::findNextBoundary(const RKTrackRep* rep,
       if (volChanged) {
 	// Move back to start.
 	gGeoManager->PopPoint();
+	tCursor = cursor;
 
 	// Extrapolation may not take the exact step length we asked
 	// for, so it can happen that a requested step < safety takes
@@ -190,7 +244,9 @@ TGeoMaterialInterface::findNextBoundary(const RKTrackRep* rep,
 
 	gGeoManager->FindNextBoundary(fabs(sMax) - s);
 	safety = gGeoManager->GetSafeDistance();
-	step = slDist = gGeoManager->GetStep();
+	slDist = gGeoManager->GetStep();
+	limitToSlabBox(safety, slDist);
+	step = slDist;
       }
     }
   }
@@ -200,12 +256,265 @@ TGeoMaterialInterface::findNextBoundary(const RKTrackRep* rep,
 double
 TGeoMaterialInterface::findNextBoundaryAndStepStraight(double sMax) {
 
+  if (tCursor.owner == this && tCursor.slab >= 0) {
+    double step = slabDistance(tCursor.pos, tCursor.dir, tCursor.slab, sMax);
+    double d = step < sMax ? step + slabNudge : step;
+    double pos[3] = {tCursor.pos[0], tCursor.pos[1], tCursor.pos[2]};
+    double dir[3] = {tCursor.dir[0], tCursor.dir[1], tCursor.dir[2]};
+    initTrack(pos[0] + d*dir[0], pos[1] + d*dir[1], pos[2] + d*dir[2],
+              dir[0], dir[1], dir[2]);
+    return step;
+  }
+
   gGeoManager->FindNextBoundaryAndStep(sMax);
   return gGeoManager->GetStep();
 
 }
 
 
+double
+TGeoMaterialInterface::findNextBoundaryInSlabs(const RKTrackRep* rep,
+                                                 const M1x7& stateOrig,
+                                                 double sMax, // signed
+                                                 bool varField)
+{
+  // Same stepping strategy as findNextBoundary, with the slab faces providing
+  // the straight line distance to the next boundary instead of the navigator.
+  const double delta(1.E-2); // cm, distance limit beneath which straight-line steps are taken.
+  const double epsilon(1.E-1); // cm, allowed upper bound on arch
+			       // deviation from straight line
+
+  M1x3 SA;
+  M1x7 state7, oldState7;
+  memcpy(oldState7, stateOrig, sizeof(state7));
+
+  int stepSign(sMax < 0 ? -1 : 1);
+  const int iSlab = tCursor.slab;
+
+  double s = 0;  // trajectory length to boundary
+
+  const unsigned maxIt = 300;
+  unsigned it = 0;
+
+  double dir[3] = {stepSign*stateOrig[3], stepSign*stateOrig[4], stepSign*stateOrig[5]};
+  double slDist = slabDistance(stateOrig, dir, iSlab, fabs(sMax));
+  double step = slDist;
+
+  while (1) {
+    if (++it > maxIt){
+      Exception exc("TGeoMaterialInterface::findNextBoundaryInSlabs ==> maximum number of iterations exceeded",__LINE__,__FILE__);
+      exc.setFatal();
+      throw exc;
+    }
+
+    // No boundary before sMax, or very close to the boundary?
+    if (s + slDist >= fabs(sMax) || slDist < delta)
+      return stepSign*(s + slDist);
+
+    memcpy(state7, stateOrig, sizeof(state7));
+    rep->RKPropagate(state7, NULL, SA, stepSign*(s + step), varField);
+
+    double dist2 = (pow(state7[0] - oldState7[0], 2)
+		    + pow(state7[1] - oldState7[1], 2)
+		    + pow(state7[2] - oldState7[2], 2));
+    double maxDeviation2 = 0.25*(step*step - dist2);
+
+    if (step > delta
+	&& maxDeviation2 > epsilon*epsilon) {
+      step = std::max(step / 2, delta);
+      continue;
+    }
+
+    if (slab(state7[0], state7[1], state7[2]) != iSlab) {
+      // A full straight line step ends on the face found for the slab
+      if (step <= delta || step >= slDist)
+	return stepSign*(s + step);
+      step = std::max(step / 2, delta);
+      continue;
+    }
+
+    // still in the same slab, advance
+    s += step;
+    memcpy(oldState7, state7, sizeof(state7));
+
+    dir[0] = stepSign*state7[3]; dir[1] = stepSign*state7[4]; dir[2] = stepSign*state7[5];
+    step = slDist = slabDistance(state7, dir, iSlab, fabs(sMax) - s);
+  }
+}
+
+
+bool
+TGeoMaterialInterface::buildSlabCache(double xMin, double xMax, double yMin, double yMax,
+                                        double zMin, double zMax, int nProbe) {
+
+  clearSlabCache();
+
+  if (!gGeoManager || nProbe <= 0
+      || xMax <= xMin || yMax <= yMin || zMax <= zMin) {
+    Exception exc("TGeoMaterialInterface::buildSlabCache ==> no geometry or invalid box",__LINE__,__FILE__);
+    exc.setFatal();
+    throw exc;
+  }
+
+  // Trace the probe lines with a private navigator, leaving the state of the
+  // global one untouched. The lines cover the box up to a small inset from its walls.
+  TGeoNavigator nav(gGeoManager);
+  std::vector<double> faces, probeFaces;
+  std::vector<TGeoMaterial*> materials, probeMaterials;
+  const double inset = 1.E-3; // cm
+
+  for (int iX = 0; iX < nProbe; ++iX) {
+    for (int iY = 0; iY < nProbe; ++iY) {
+      double fX = nProbe > 1 ? double(iX)/(nProbe - 1) : 0.5;
+      double fY = nProbe > 1 ? double(iY)/(nProbe - 1) : 0.5;
+      double x = xMin + inset + fX*(xMax - xMin - 2*inset);
+      double y = yMin + inset + fY*(yMax - yMin - 2*inset);
+      if (!traceSlabs(nav, x, y, zMin, zMax, probeFaces, probeMaterials)) {
+        std::cerr << "TGeoMaterialInterface::buildSlabCache: line at x=" << x << " y=" << y
+                  << " leaves the geometry, no slab cache\n";
+        return false;
+      }
+      if (iX == 0 && iY == 0) {
+        faces = probeFaces;
+        materials = probeMaterials;
+        continue;
+      }
+      bool same = (probeMaterials == materials);
+      for (size_t i = 0; same && i < faces.size(); ++i)
+        same = fabs(probeFaces[i] - faces[i]) < slabTolerance;
+      if (!same) {
+        std::cerr << "TGeoMaterialInterface::buildSlabCache: material along z at x=" << x << " y=" << y
+                  << " differs from x=" << xMin + inset << " y=" << yMin + inset
+                  << ", the box is not layered in z, no slab cache\n";
+        return false;
+      }
+    }
+  }
+
+  slabBox_[0] = xMin; slabBox_[1] = xMax; slabBox_[2] = yMin; slabBox_[3] = yMax;
+  slabZ_.swap(faces);
+  for (TGeoMaterial* mat : materials)
+    slabMaterials_.push_back(MaterialProperties(mat->GetDensity(), mat->GetZ(), mat->GetA(),
+                                                mat->GetRadLen(), MeanExcEnergy_get(mat)));
+
+  std::cout << "TGeoMaterialInterface::buildSlabCache: " << slabMaterials_.size() << " slabs from z="
+            << slabZ_.front() << " to " << slabZ_.back() << " cm, " << getSlabBudget() << " X0\n";
+  return true;
+}
+
+
+void
+TGeoMaterialInterface::clearSlabCache() {
+  slabZ_.clear();
+  slabMaterials_.clear();
+  if (tCursor.owner == this)
+    tCursor = slabCursor();
+}
+
+
+double
+TGeoMaterialInterface::getSlabBudget() const {
+  double budget = 0;
+  for (size_t i = 0; i < slabMaterials_.size(); ++i)
+    budget += (slabZ_[i+1] - slabZ_[i])/slabMaterials_[i].getRadLen();
+  return budget;
+}
+
+
+bool
+TGeoMaterialInterface::traceSlabs(TGeoNavigator& nav, double x, double y, double zMin, double zMax,
+                                    std::vector<double>& faces, std::vector<TGeoMaterial*>& materials) const {
+
+  faces.assign(1, zMin);
+  materials.clear();
+
+  const unsigned maxIt = 10000;
+  double z = zMin;
+  nav.InitTrack(x, y, z, 0., 0., 1.);
+  for (unsigned it = 0; z < zMax; ++it) {
+    if (it > maxIt || nav.IsOutside() || !nav.GetCurrentVolume()->GetMedium())
+      return false;
+    TGeoMaterial* mat = nav.GetCurrentVolume()->GetMedium()->GetMaterial();
+    nav.FindNextBoundaryAndStep(zMax - z);
+    z = std::min(z + nav.GetStep(), zMax);
+    // volumes of the same material next to each other make one slab
+    if (!materials.empty() && materials.back() == mat) {
+      faces.back() = z;
+    } else {
+      materials.push_back(mat);
+      faces.push_back(z);
+    }
+  }
+  return true;
+}
+
+
+int
+TGeoMaterialInterface::slab(double x, double y, double z) const {
+  if (slabMaterials_.empty()
+      || x < slabBox_[0] || x >= slabBox_[1] || y < slabBox_[2] || y >= slabBox_[3]
+      || z < slabZ_.front() || z >= slabZ_.back())
+    return -1;
+  return int(std::upper_bound(slabZ_.begin(), slabZ_.end(), z) - slabZ_.begin()) - 1;
+}
+
+
+double
+TGeoMaterialInterface::slabDistance(const double* pos, const double* dir, int iSlab, double sMax) const {
+
+  double dist = sMax;
+  // faces of the slab
+  if (dir[2] > 0.)
+    dist = std::min(dist, (slabZ_[iSlab+1] - pos[2])/dir[2]);
+  else if (dir[2] < 0.)
+    dist = std::min(dist, (slabZ_[iSlab] - pos[2])/dir[2]);
+  // walls of the box
+  for (int k = 0; k < 2; ++k) {
+    if (dir[k] > 0.)
+      dist = std::min(dist, (slabBox_[2*k+1] - pos[k])/dir[k]);
+    else if (dir[k] < 0.)
+      dist = std::min(dist, (slabBox_[2*k] - pos[k])/dir[k]);
+  }
+  return std::max(dist, 0.);
+}
+
+
+void
+TGeoMaterialInterface::limitToSlabBox(double& safety, double& step) const {
+
+  if (!hasSlabCache())
+    return;
+
+  const double* pos = gGeoManager->GetCurrentPoint();
+  const double* dir = gGeoManager->GetCurrentDirection();
+  const double lo[3] = {slabBox_[0], slabBox_[2], slabZ_.front()};
+  const double hi[3] = {slabBox_[1], slabBox_[3], slabZ_.back()};
+
+  // distance from the point to the box
+  double dist2 = 0;
+  for (int k = 0; k < 3; ++k) {
+    double gap = std::max(lo[k] - pos[k], pos[k] - hi[k]);
+    if (gap > 0.) dist2 += gap*gap;
+  }
+  safety = std::min(safety, sqrt(dist2));
+
+  // straight line entry into the box
+  double tIn = 0., tOut = step;
+  for (int k = 0; k < 3 && tIn <= tOut; ++k) {
+    if (dir[k] != 0.) {
+      double t1 = (lo[k] - pos[k])/dir[k];
+      double t2 = (hi[k] - pos[k])/dir[k];
+      tIn = std::max(tIn, std::min(t1, t2));
+      tOut = std::min(tOut, std::max(t1, t2));
+    } else if (pos[k] < lo[k] || pos[k] > hi[k]) {
+      tOut = -1.;
+    }
+  }
+  if (tIn <= tOut)
+    step = std::min(step, tIn);
+}
+
+
 
 
 /*
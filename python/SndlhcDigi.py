@@ -100,6 +100,8 @@ class SndlhcDigi:
                if self.digiScifi.GetSize() == index: self.digiScifi.Expand(index+100)
                self.digiScifi[index]=aHit
                index+=1
+        # Hit2MCPoints is filled fastest in ascending detID order
+        for detID in sorted(mcPoints):
                for k in mcPoints[detID]:
                     mcLinks.Add(detID,k, mcPoints[detID][k]/norm[detID])
         self.digiScifi2MCPoints[0]=mcLinks
@@ -131,6 +133,7 @@ class SndlhcDigi:
             if self.digiMuFilter.GetSize() == index: self.digiMuFilter.Expand(index+100)
             self.digiMuFilter[index]=aHit
             index+=1
+        for detID in sorted(mcPoints):
             for k in mcPoints[detID]:
                 mcLinks.Add(detID,k, mcPoints[detID][k]/norm[detID])
         self.digiMuFilter2MCPoints[0]=mcLinks
@@ -1,4 +1,4 @@
-import ROOT
+import ROOT,os
 import shipunit as u
 import shipLHC_conf as sndDet_conf
 from ShipGeoConfig import ConfigRegistry
@@ -15,6 +15,9 @@ class GeoInterface():
    run = "notNeeded"
    self.modules = sndDet_conf.configure(run,self.snd_geo)
    self.sGeo = self.fgeo.FAIRGeom
+# fibre to SiPM mapping is cached next to the geometry file, or in the temp directory for remote files
+   if geoFile.find('root://')<0:
+       self.modules['Scifi'].SetSiPMmapDir(os.path.dirname(os.path.abspath(geoFile)))
    self.modules['Scifi'].SiPMmapping()
    lsOfGlobals = ROOT.gROOT.GetListOfGlobals()
    for m in self.modules: lsOfGlobals.Add(self.modules[m])
@@ -24,11 +24,11 @@ const genfit::MeasuredStateOnPlane& getFittedState(genfit::Track* theTrack, int
 class Tracking(ROOT.FairTask):
  " Tracking "
  def Init(self,online=False):
-   geoMat =  ROOT.genfit.TGeoMaterialInterface()
+   self.geoMat =  ROOT.genfit.TGeoMaterialInterface()
    bfield     = ROOT.genfit.ConstField(0,0,0)   # constant field of zero
    fM = ROOT.genfit.FieldManager.getInstance()
    fM.init(bfield)
-   ROOT.genfit.MaterialEffects.getInstance().init(geoMat)
+   ROOT.genfit.MaterialEffects.getInstance().init(self.geoMat)
    ROOT.genfit.MaterialEffects.getInstance().setNoEffects()
    lsOfGlobals  = ROOT.gROOT.GetListOfGlobals()
    self.scifiDet = lsOfGlobals.FindObject('Scifi')
@@ -41,6 +41,9 @@ class Tracking(ROOT.FairTask):
    
    self.fitter = ROOT.genfit.KalmanFitter()
    self.fitter.setMaxIterations(50)
+   # fits the track candidates of an event together, serially unless setNThreads(n) is called
+   self.fitService = ROOT.genfit.TrackFitService(1)
+   self.fitService.setMaxIterations(50)
    #internal storage of fitted tracks
    self.fittedTracks = ROOT.TObjArray(10)
    
@@ -77,16 +80,37 @@ class Tracking(ROOT.FairTask):
            self.clusScifi.Delete()
            self.scifiCluster()
            self.trackCandidates['Scifi'] = self.Scifi_track()
+    tracks = []
     for x in self.trackCandidates:
       for aTrack in self.trackCandidates[x]:
-           rc = self.fitTrack(aTrack)
+           rc = self.makeTrack(aTrack)
            if type(rc)==type(1):
                 print('trackfit failed',rc,aTrack)
            else:
                 if x=='DS':   rc.SetUniqueID(3)
                 if x=='Scifi': rc.SetUniqueID(1)
+                tracks.append(rc)
+    if len(tracks)==0: return
+    toFit = ROOT.std.vector('genfit::Track*')()
+    for theTrack in tracks: toFit.push_back(theTrack)
+    self.fitService.fitTracks(toFit)
+    for theTrack in tracks:
+           rc = self.checkFit(theTrack)
+           if type(rc)==type(1):
+                print('trackfit failed',rc,theTrack)
+           else:
                 self.fittedTracks.Add(rc)
 
+ def setNThreads(self,n):
+# fit the track candidates of an event on n threads, 0 uses one thread per core
+    self.fitService.setNThreads(n)
+
+ def setMaterialEffects(self,envelope=None):
+# switch on material effects in the fit, envelope = (xMin,xMax,yMin,yMax,zMin,zMax) of a region
+# layered in z, e.g. the Scifi and MuFilter planes, whose material is then taken from a slab cache
+    ROOT.genfit.MaterialEffects.getInstance().setNoEffects(False)
+    if envelope: self.geoMat.buildSlabCache(*envelope)
+
  def DStrack(self,nPlanes = 2, nHits = 2):
     event = self.event
     trackCandidates = []
@@ -304,6 +328,14 @@ class Tracking(ROOT.FairTask):
 
  def fitTrack(self,hitlist):
 # hitlist:  clusterID: [A,B] endpoints of scifiCluster
+    theTrack = self.makeTrack(hitlist)
+    if type(theTrack)==type(1): return theTrack
+# do the fit
+    self.fitter.processTrack(theTrack) # processTrackWithRep(theTrack,rep,True)
+    return self.checkFit(theTrack)
+
+ def makeTrack(self,hitlist):
+# track with seed state and measurements sorted in z, not yet fitted
     hitPosLists={}
     trID = 0
 
@@ -372,8 +404,9 @@ class Tracking(ROOT.FairTask):
         print("track not consistent")
         theTrack.Delete()
         return -2
-# do the fit
-    self.fitter.processTrack(theTrack) # processTrackWithRep(theTrack,rep,True)
+    return theTrack
+
+ def checkFit(self,theTrack):
     fitStatus   = theTrack.getFitStatus()
     if self.Debug: print("Fit result: converged chi2 Ndf",fitStatus.isFitConverged(),fitStatus.getChi2(),fitStatus.getNdf())
     if not fitStatus.isFitConverged() and 0>1:
@@ -575,6 +575,29 @@ void MuFilter::GetPosition(Int_t fDetectorID, TVector3& vLeft, TVector3& vRight)
        if (subsystem==1){return conf_ints["MuFilter/UpstreamnSides"];}
        return conf_ints["MuFilter/DownstreamnSides"];
   }
+  const MuFilterDigiPar& MuFilter::GetDigiPar(Int_t detID){
+       auto it = fDigiPar.find(detID);
+       if (it!=fDigiPar.end()){return it->second;}
+       MuFilterDigiPar& par = fDigiPar[detID];
+       par.nSiPMs = GetnSiPMs(detID);
+       if (floor(detID/10000)==3&&detID%1000>59) par.nSides = GetnSides(detID) - 1;
+       else par.nSides = GetnSides(detID);
+       par.timeResol = conf_floats["MuFilter/timeResol"];
+       if (floor(detID/10000)==3) {
+              if (par.nSides==2){par.attLength = conf_floats["MuFilter/DsAttenuationLength"];}
+              else                    {par.attLength = conf_floats["MuFilter/DsTAttenuationLength"];}
+              par.siPMcalibration = conf_floats["MuFilter/DsSiPMcalibration"];
+              par.propspeed = conf_floats["MuFilter/DsPropSpeed"];
+       }
+       else {
+              par.attLength = conf_floats["MuFilter/VandUpAttenuationLength"];
+              par.siPMcalibration = conf_floats["MuFilter/VandUpSiPMcalibration"];
+              par.siPMcalibrationS = conf_floats["MuFilter/VandUpSiPMcalibrationS"];
+              par.propspeed = conf_floats["MuFilter/VandUpPropSpeed"];
+       }
+       GetPosition(detID, par.vLeft, par.vRight);
+       return par;
+  }
 /*
 Double_t MuFilter::GetCorrectedTime(Int_t fDetectorID, Int_t channel, Double_t rawTime, Double_t L){
  expect time in u.ns  and  path length to sipm u.cm 
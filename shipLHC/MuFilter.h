@@ -12,6 +12,7 @@
 #include "Rtypes.h"                     // for ShipMuonShield::Class, Bool_t, etc
 
 #include <string>                       // for string
+#include <map>
 
 #include "TVector3.h"
 #include "TString.h"
@@ -21,6 +22,14 @@ class MuFilterPoint;
 class FairVolume;
 class TClonesArray;
 
+/** Digitisation parameters of one bar, resolved once from the configuration and the geometry **/
+struct MuFilterDigiPar
+{
+	Int_t nSiPMs{}, nSides{};
+	Float_t timeResol{}, attLength{}, siPMcalibration{}, siPMcalibrationS{}, propspeed{};
+	TVector3 vLeft, vRight;   // bar ends in the global frame
+};
+
 class MuFilter : public FairDetector
 {
 	public:
@@ -36,10 +45,12 @@ class MuFilter : public FairDetector
                  void GetLocalPosition(Int_t id, TVector3& vLeft, TVector3& vRight);
                  Int_t GetnSiPMs(Int_t detID);
                  Int_t GetnSides(Int_t detID);
+    /** Digitisation parameters of a bar, cached until the configuration changes **/
+                 const MuFilterDigiPar& GetDigiPar(Int_t detID);
 
-		void SetConfPar(TString name, Float_t value){conf_floats[name]=value;}
-		void SetConfPar(TString name, Int_t value){conf_ints[name]=value;}
-		void SetConfPar(TString name, TString value){conf_strings[name]=value;}
+		void SetConfPar(TString name, Float_t value){conf_floats[name]=value; fDigiPar.clear();}
+		void SetConfPar(TString name, Int_t value){conf_ints[name]=value; fDigiPar.clear();}
+		void SetConfPar(TString name, TString value){conf_strings[name]=value; fDigiPar.clear();}
 		Float_t  GetConfParF(TString name){return conf_floats[name];} 
 		Int_t       GetConfParI(TString name){return conf_ints[name];}
 		TString  GetConfParS(TString name){return conf_strings[name];}
@@ -98,6 +109,7 @@ class MuFilter : public FairDetector
 			std::map<TString,Float_t> conf_floats;
 			std::map<TString,Int_t> conf_ints;
 			std::map<TString,TString> conf_strings;
+			std::map<Int_t,MuFilterDigiPar> fDigiPar; //!
 
 	protected:
 
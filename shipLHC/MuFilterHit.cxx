@@ -38,32 +38,25 @@ MuFilterHit::MuFilterHit(Int_t detID,Int_t nP,Int_t nS)
 
 // -----   constructor from MuFilterPoint   ------------------------------------------
 MuFilterHit::MuFilterHit(Int_t detID, std::vector<MuFilterPoint*> V)
+  : MuFilterHit(detID, V,
+                dynamic_cast<MuFilter*> (gROOT->GetListOfGlobals()->FindObject("MuFilter"))->GetDigiPar(detID))
+{
+}
+MuFilterHit::MuFilterHit(Int_t detID, const std::vector<MuFilterPoint*>& V, const MuFilterDigiPar& par)
   : SndlhcHit()
 {
-     MuFilter* MuFilterDet = dynamic_cast<MuFilter*> (gROOT->GetListOfGlobals()->FindObject("MuFilter"));
-     // get parameters from the MuFilter detector for simulating the digitized information
-     nSiPMs  = MuFilterDet->GetnSiPMs(detID);
-     if (floor(detID/10000)==3&&detID%1000>59) nSides = MuFilterDet->GetnSides(detID) - 1;
-     else nSides = MuFilterDet->GetnSides(detID);
-
-     Float_t timeResol = MuFilterDet->GetConfParF("MuFilter/timeResol");
+     // parameters from the MuFilter detector for simulating the digitized information
+     nSiPMs  = par.nSiPMs;
+     nSides = par.nSides;
 
-     Float_t attLength=0;
-     Float_t siPMcalibration=0;
-     Float_t siPMcalibrationS=0;
-     Float_t propspeed =0;
-     if (floor(detID/10000)==3) { 
-              if (nSides==2){attLength = MuFilterDet->GetConfParF("MuFilter/DsAttenuationLength");}
-              else                    {attLength = MuFilterDet->GetConfParF("MuFilter/DsTAttenuationLength");}
-              siPMcalibration = MuFilterDet->GetConfParF("MuFilter/DsSiPMcalibration");
-              propspeed = MuFilterDet->GetConfParF("MuFilter/DsPropSpeed");
-     }
-     else { 
-              attLength = MuFilterDet->GetConfParF("MuFilter/VandUpAttenuationLength");
-              siPMcalibration = MuFilterDet->GetConfParF("MuFilter/VandUpSiPMcalibration");
-              siPMcalibrationS = MuFilterDet->GetConfParF("MuFilter/VandUpSiPMcalibrationS");
-              propspeed = MuFilterDet->GetConfParF("MuFilter/VandUpPropSpeed");
-     }
+     Float_t timeResol = par.timeResol;
+     Float_t attLength = par.attLength;
+     Float_t siPMcalibration = par.siPMcalibration;
+     Float_t siPMcalibrationS = par.siPMcalibrationS;
+     Float_t propspeed = par.propspeed;
+     // Bar ends, the same for all points
+     const TVector3& vLeft = par.vLeft;
+     const TVector3& vRight = par.vRight;
 
      for (unsigned int j=0; j<16; ++j){
         signals[j] = -1;
@@ -81,9 +74,7 @@ MuFilterHit::MuFilterHit(Int_t detID, std::vector<MuFilterPoint*> V)
         Double_t signal = (*p)->GetEnergyLoss();
      
       // Find distances from MCPoint centre to ends of bar 
-        TVector3 vLeft,vRight;
         TVector3 impact((*p)->GetX(),(*p)->GetY() ,(*p)->GetZ() );
-        MuFilterDet->GetPosition(fDetectorID,vLeft, vRight);
         Double_t distance_Left    =  (vLeft-impact).Mag();
         Double_t distance_Right =  (vRight-impact).Mag();
         signalLeft+=signal*TMath::Exp(-distance_Left/attLength);
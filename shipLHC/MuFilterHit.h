@@ -6,6 +6,9 @@
 #include "TObject.h"
 #include "TVector3.h"
 #include <map>
+#include <vector>
+
+struct MuFilterDigiPar;
 
 class MuFilterHit : public SndlhcHit
 {
@@ -19,6 +22,8 @@ class MuFilterHit : public SndlhcHit
 
     // Constructor from MuFilterPoint
     MuFilterHit(Int_t detID,std::vector<MuFilterPoint*>);
+    // Constructor from MuFilterPoint with the resolved parameters of the bar, see MuFilter::GetDigiPar
+    MuFilterHit(Int_t detID,const std::vector<MuFilterPoint*>& V,const MuFilterDigiPar& par);
 
  /** Destructor **/
     virtual ~MuFilterHit();
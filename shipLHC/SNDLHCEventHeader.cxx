@@ -72,11 +72,21 @@ string SNDLHCEventHeader::GetTimeAsString()
    return asctime(GMTtime);
 }
 
+uint8_t SNDLHCEventHeader::GetFastNoiseFilterBits() const
+{
+   return (fFlags & FAST_FILTER_MASK) >> maskToShift(FAST_FILTER_MASK);
+}
+
+uint16_t SNDLHCEventHeader::GetAdvNoiseFilterBits() const
+{
+   return (fFlags & ADVANCED_FILTER_MASK) >> maskToShift(ADVANCED_FILTER_MASK);
+}
+
 map<string, bool> SNDLHCEventHeader::GetFastNoiseFilters()
 {
    map<string, bool> FastNoiseFilters{};
 
-   auto base = (fFlags & FAST_FILTER_MASK) >> maskToShift(FAST_FILTER_MASK);
+   auto base = GetFastNoiseFilterBits();
    FastNoiseFilters["SciFi"]       = base & FAST_FILTER_SCIFI;
    FastNoiseFilters["SciFi_Total"] = base & FAST_FILTER_SCIFI_TOTAL;
    FastNoiseFilters["US"]          = base & FAST_FILTER_US;
@@ -92,7 +102,7 @@ map<string, bool> SNDLHCEventHeader::GetAdvNoiseFilters()
 {
    map<string, bool> AdvNoiseFilters{};
 
-   auto base = (fFlags & ADVANCED_FILTER_MASK) >> maskToShift(ADVANCED_FILTER_MASK);
+   auto base = GetAdvNoiseFilterBits();
    AdvNoiseFilters["SciFi_Planes"]  = base & ADVANCED_FILTER_SCIFI_PLANES;
    AdvNoiseFilters["SciFi_Hits"]    = base & ADVANCED_FILTER_SCIFI_HITS;
    AdvNoiseFilters["US_Planes"]     = base & ADVANCED_FILTER_US_PLANES;
@@ -46,6 +46,9 @@ class SNDLHCEventHeader : public TNamed
     uint16_t GetFillNumber() const { return fFillNumber; }
     int GetAccMode() const { return fAccMode; }
     int GetBeamMode() const { return fBeamMode; }
+    /** Filter bits without building maps, FAST_FILTER_* and ADVANCED_FILTER_* constants **/
+    uint8_t GetFastNoiseFilterBits() const;
+    uint16_t GetAdvNoiseFilterBits() const;
     map<string, bool> GetFastNoiseFilters();
     map<string, bool> GetAdvNoiseFilters();
     vector<string> GetPassedFastNFCriteria();
@@ -35,14 +35,45 @@
 #include "ShipStack.h"
 
 #include "TGeoUniformMagField.h"
+#include "TSystem.h"
 #include <stddef.h>                     // for NULL
 #include <iostream>                     // for operator<<, basic_ostream, etc
+#include <fstream>
+#include <algorithm>
+#include <cstring>                      // for memcmp
+#include <cstdio>                       // for rename
 
 using std::cout;
 using std::endl;
 
 using namespace ShipUnit;
 
+namespace {
+// Cached fibre to SiPM mapping, see Scifi::SiPMmapping
+const char kSiPMmapMagic[8] = {'S','N','D','S','I','P','M','1'};
+struct SiPMmapHeader
+{
+	char magic[8];
+	ULong64_t geoHash;   // of the fibre and SiPM channel positions
+	ULong64_t n;
+	ULong64_t checksum;  // of the entries
+};
+struct SiPMmapEntry
+{
+	Int_t sipm;
+	Int_t fibre;
+	Float_t weight;
+	Float_t pos;
+};
+// FNV-1a 64 bit hash
+ULong64_t fnv1a(const void* data, size_t n, ULong64_t h = 14695981039346656037ULL)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < n; i++) { h ^= p[i]; h *= 1099511628211ULL; }
+	return h;
+}
+}
+
 Scifi::Scifi()
 : FairDetector("Scifi", "", kTRUE),
 fTrackID(-1),
@@ -459,7 +490,121 @@ Double_t Scifi::GetCorrectedTime(Int_t fDetectorID, Double_t rawTime, Double_t L
 	return rawTime-cor;
 }
 
-void Scifi::GetPosition(Int_t fDetectorID, TVector3& A, TVector3& B) 
+/** Position lookup, from the channel cache which is (re)built on first use after a change of alignment **/
+void Scifi::GetPosition(Int_t fDetectorID, TVector3& A, TVector3& B)
+{
+	if (!fPosCacheValid.load(std::memory_order_acquire)){BuildPositionCache();}
+	if (!fFibreEnds.Get(fDetectorID, A, B)){GetPositionFromGeo(fDetectorID, A, B);}
+}
+void Scifi::GetSiPMPosition(Int_t SiPMChan, TVector3& A, TVector3& B)
+{
+	if (!fPosCacheValid.load(std::memory_order_acquire)){BuildPositionCache();}
+	if (!fSiPMEnds.Get(SiPMChan, A, B)){GetSiPMPositionFromGeo(SiPMChan, A, B);}
+}
+void Scifi::BuildPositionCache()
+{
+	std::lock_guard<std::mutex> lock(fPosCacheMutex);
+	if (fPosCacheValid.load(std::memory_order_relaxed)){return;}
+	TGeoNavigator* nav = gGeoManager->GetCurrentNavigator();
+	if (!nav){nav = gGeoManager->AddNavigator();}
+	std::vector<Int_t> stations;
+	for (Int_t s = 1; gGeoManager->FindVolumeFast(Form("ScifiHorPlaneVol%i", s)); s++){stations.push_back(s);}
+
+  // fibres: walk the mats of each plane, fibre node numbers are 1T1RFFF
+	std::vector<Int_t> ids;
+	std::vector<Double_t> ends;
+	Double_t dz = -1;
+	for (Int_t s : stations){
+		for (Int_t t = 0; t < 2; t++){
+			TString path = Form("/cave_1/Detector_0/volTarget_1/ScifiVolume%i_%i000000/Scifi%sPlaneVol%i_%i000000",
+			                    s, s, t==0 ? "Hor" : "Vert", s, s);
+			if (!nav->cd(path)){continue;}
+			auto plane = nav->GetCurrentNode()->GetVolume();
+			for (Int_t imat = 0; imat < plane->GetNdaughters(); imat++){
+				Int_t m = (plane->GetNode(imat)->GetNumber()/10000)%10;
+				nav->CdDown(imat);
+				auto mat = nav->GetCurrentNode()->GetVolume();
+				for (Int_t ifibre = 0; ifibre < mat->GetNdaughters(); ifibre++){
+					nav->CdDown(ifibre);
+					TGeoNode* fibre = nav->GetCurrentNode();
+					if (dz<0){dz = dynamic_cast<TGeoBBox*>(fibre->GetVolume()->GetShape())->GetDZ();}
+					Int_t n = fibre->GetNumber();
+					ids.push_back(s*1000000 + t*100000 + m*10000 + n%10000);
+					Double_t top[3] = {0,0,dz};
+					Double_t bot[3] = {0,0,-dz};
+					Double_t Gtop[3],Gbot[3];
+					nav->LocalToMaster(top, Gtop);   nav->LocalToMaster(bot, Gbot);
+					ends.insert(ends.end(), Gtop, Gtop+3);
+					ends.insert(ends.end(), Gbot, Gbot+3);
+					nav->CdUp();
+				}
+				nav->CdUp();
+			}
+		}
+	}
+	fFibreEnds.Fill(ids, ends);
+
+  // SiPM channels: need the local positions from SiPMmapping, otherwise no cache
+	ids.clear();
+	ends.clear();
+	TVector3 A, B;
+	for (Int_t s : stations){
+		for (Int_t t = 0; t < 2; t++){
+			for (auto& p : SiPMPos){
+				Int_t id = s*1000000 + t*100000 + p.first;
+				GetSiPMPositionFromGeo(id, A, B);
+				ids.push_back(id);
+				ends.insert(ends.end(), {A.X(), A.Y(), A.Z(), B.X(), B.Y(), B.Z()});
+			}
+		}
+	}
+	fSiPMEnds.Fill(ids, ends);
+	fPosCacheValid.store(true, std::memory_order_release);
+}
+void Scifi::ChannelEnds::Fill(const std::vector<Int_t>& ids, const std::vector<Double_t>& ends)
+{
+	Int_t hi[5];
+	for (Int_t d = 0; d < 5; d++){lo[d] = 0; n[d] = 0; hi[d] = -1;}
+	for (size_t i = 0; i < ids.size(); i++){
+		Int_t digits[5];
+		Split(ids[i], digits);
+		for (Int_t d = 0; d < 5; d++){
+			if (i==0 || digits[d]<lo[d]){lo[d] = digits[d];}
+			if (i==0 || digits[d]>hi[d]){hi[d] = digits[d];}
+		}
+	}
+	Int_t size = 1;
+	for (Int_t d = 0; d < 5; d++){n[d] = hi[d]-lo[d]+1; size *= n[d];}
+	fEnds.assign(6*size, 0);
+	fFilled.assign(size, 0);
+	for (size_t i = 0; i < ids.size(); i++){
+		Int_t k = Index(ids[i]);
+		std::copy(ends.begin()+6*i, ends.begin()+6*i+6, fEnds.begin()+6*k);
+		fFilled[k] = 1;
+	}
+}
+Int_t Scifi::ChannelEnds::Index(Int_t id) const
+{
+	Int_t digits[5];
+	Split(id, digits);
+	Int_t k = 0;
+	for (Int_t d = 0; d < 5; d++){
+		Int_t x = digits[d]-lo[d];
+		if (x<0 || x>=n[d]){return -1;}
+		k = k*n[d] + x;
+	}
+	return k;
+}
+Bool_t Scifi::ChannelEnds::Get(Int_t id, TVector3& A, TVector3& B) const
+{
+	Int_t k = Index(id);
+	if (k<0 || !fFilled[k]){return kFALSE;}
+	const Double_t* e = &fEnds[6*k];
+	A.SetXYZ(e[0],e[1],e[2]);
+	B.SetXYZ(e[3],e[4],e[5]);
+	return kTRUE;
+}
+void Scifi::GetPositionFromGeo(Int_t fDetectorID, TVector3& A, TVector3& B)
 {
 //	TGeoVolumeAssembly *SiPMmapVol = gGeoManager->FindVolumeFast("SiPMmapVol");
 //	if(!SiPMmapVol ){SiPMmapVol=SiPMOverlap();}
@@ -522,7 +667,7 @@ TVector3 Scifi::GetLocalPos(Int_t id, TVector3* glob){
 	return TVector3(aloc[0],aloc[1],aloc[2]);
 }
 
-void Scifi::GetSiPMPosition(Int_t SiPMChan, TVector3& A, TVector3& B) 
+void Scifi::GetSiPMPositionFromGeo(Int_t SiPMChan, TVector3& A, TVector3& B)
 {
 /* STMRFFF
  First digit S: 		station # within the sub-detector
@@ -620,6 +765,7 @@ Double_t Scifi::area(Double_t a,Double_t R,Double_t xL,Double_t xR)
 }
 
 void Scifi::SiPMmapping(){
+	if (!fibresSiPM.empty()){return;}   // already done, e.g. by the geometry interface
 	Float_t fibresRadius = -1;
 	Float_t dSiPM = -1;
 	TGeoNode* vol;
@@ -628,6 +774,9 @@ void Scifi::SiPMmapping(){
 	auto sipm    = gGeoManager->FindVolumeFast("SiPMmapVol");
 	TObjArray* Nodes = sipm->GetNodes();
 	auto plane  = gGeoManager->FindVolumeFast("ScifiHorPlaneVol1");
+  // collect fibre and SiPM channel positions, they also identify the geometry version of the cached mapping
+	std::vector<Int_t> fibreMat, fibreID, chanMat, chanID;
+	std::vector<Float_t> fibrePos, chanPos;
 	for (int imat = 0; imat < plane->GetNodes()->GetEntriesFast(); imat++){
 		auto mat =  static_cast<TGeoNode*>(plane->GetNodes()->At(imat));
 		Float_t t1 = mat->GetMatrix()->GetTranslation()[1];
@@ -640,28 +789,46 @@ void Scifi::SiPMmapping(){
 				fibresRadius = S->GetDX();
 			}
 			Float_t t2 = fibre->GetMatrix()->GetTranslation()[1];
-			Int_t fID = fibre->GetNumber()%100000 + imat*1e4;     // local fibre number, global fibre number = SO+fID
-			Float_t a = t1+t2;
-
+			fibreMat.push_back(imat);
+			fibreID.push_back(fibre->GetNumber()%100000 + imat*1e4);     // local fibre number, global fibre number = SO+fID
+			fibrePos.push_back(t1+t2);
+		}
+	}
+	for(Int_t nChan = 0; nChan< Nodes->GetEntriesFast();nChan++){        // 12 SiPMs total and 4 SiPMs per mat times 128 channels
+		vol = static_cast<TGeoNode*>(Nodes->At(nChan));
+		if  (dSiPM<0){
+			TGeoBBox* B = dynamic_cast<TGeoBBox*>(vol->GetVolume()->GetShape());
+			dSiPM = B->GetDY();
+		}
+		Int_t N = vol->GetNumber()%100000;
+		chanMat.push_back(int(N/10000));
+		chanID.push_back(N);
+		chanPos.push_back(vol->GetMatrix()->GetTranslation()[1]);
+	}
+	ULong64_t geoHash = fnv1a(&fibresRadius, sizeof(fibresRadius));
+	geoHash = fnv1a(&dSiPM, sizeof(dSiPM), geoHash);
+	geoHash = fnv1a(fibreID.data(), fibreID.size()*sizeof(Int_t), geoHash);
+	geoHash = fnv1a(fibrePos.data(), fibrePos.size()*sizeof(Float_t), geoHash);
+	geoHash = fnv1a(chanID.data(), chanID.size()*sizeof(Int_t), geoHash);
+	geoHash = fnv1a(chanPos.data(), chanPos.size()*sizeof(Float_t), geoHash);
+
+	if (!ReadSiPMmap(geoHash)){
 	//  check for overlap with any of the SiPM channels in the same mat
-			for(Int_t nChan = 0; nChan< Nodes->GetEntriesFast();nChan++){        // 12 SiPMs total and 4 SiPMs per mat times 128 channels
-				vol = static_cast<TGeoNode*>(Nodes->At(nChan));
-				Int_t N = vol->GetNumber()%100000;
-				if (imat!=int(N/10000)){continue;}
-				Float_t xcentre = vol->GetMatrix()->GetTranslation()[1];
-				if  (dSiPM<0){
-					TGeoBBox* B = dynamic_cast<TGeoBBox*>(vol->GetVolume()->GetShape());
-					dSiPM = B->GetDY();
-				}
+		for (size_t i = 0; i < fibreID.size(); i++){
+			Float_t a = fibrePos[i];
+			for (size_t n = 0; n < chanID.size(); n++){
+				if (fibreMat[i]!=chanMat[n]){continue;}
+				Float_t xcentre = chanPos[n];
 				if (TMath::Abs(xcentre-a)>4*fibresRadius){ continue;} // no need to check further
 				Float_t W = area(a,fibresRadius,xcentre-dSiPM,xcentre+dSiPM);
 				if (W<0){ continue;}
 				std::array<float, 2> Wa;
 				Wa[0] = W;
 				Wa[1] = a;
-				fibresSiPM[N][fID] = Wa;
+				fibresSiPM[chanID[n]][fibreID[i]] = Wa;
 			}
 		}
+		WriteSiPMmap(geoHash);
 	}
   // calculate also local SiPM positions based on fibre positions and their fraction
   // probably an overkill, maximum difference between weighted average and central position < 6 micron.
@@ -689,6 +856,73 @@ void Scifi::SiPMmapping(){
 			siPMFibres[nfibre][N]=itx->second;
 		}
 	}
+// and its flat version for the digitisation, SiPM channels of fibre fID are [fFibreOffset[fID], fFibreOffset[fID+1])
+	Int_t maxFibre = siPMFibres.empty() ? -1 : siPMFibres.rbegin()->first;
+	fFibreOffset.assign(maxFibre+2, 0);
+	fFibreSiPM.clear();
+	fFibreWeight.clear();
+	for (auto& f : siPMFibres)
+	{
+		for (auto& c : f.second)
+		{
+			fFibreSiPM.push_back(c.first);
+			fFibreWeight.push_back(c.second[0]);
+		}
+		fFibreOffset[f.first+1] = fFibreSiPM.size();
+	}
+	for (Int_t i = 1; i < maxFibre+2; i++){fFibreOffset[i] = std::max(fFibreOffset[i], fFibreOffset[i-1]);}
+	fPosCacheValid = false;
+}
+/** File of the cached fibre to SiPM mapping for a given geometry **/
+TString Scifi::SiPMmapFile(ULong64_t geoHash)
+{
+	TString dir = fSiPMmapDir;
+	if (dir=="" || gSystem->AccessPathName(dir, kWritePermission)){
+		dir = gSystem->Getenv("SNDSW_GEO_CACHE") ? gSystem->Getenv("SNDSW_GEO_CACHE")
+		                                         : Form("%s/sndsw_geo_cache", gSystem->TempDirectory());
+	}
+	return Form("%s/SiPMmap_%016llx.bin", dir.Data(), (unsigned long long)geoHash);
+}
+Bool_t Scifi::ReadSiPMmap(ULong64_t geoHash)
+{
+	TString fname = SiPMmapFile(geoHash);
+	std::ifstream in(fname.Data(), std::ios::binary);
+	if (!in){return kFALSE;}
+	SiPMmapHeader h{};
+	in.read(reinterpret_cast<char*>(&h), sizeof(h));
+	if (!in || memcmp(h.magic, kSiPMmapMagic, sizeof(h.magic))!=0 || h.geoHash!=geoHash){return kFALSE;}
+	std::vector<SiPMmapEntry> entries(h.n);
+	in.read(reinterpret_cast<char*>(entries.data()), entries.size()*sizeof(SiPMmapEntry));
+	if (!in || fnv1a(entries.data(), entries.size()*sizeof(SiPMmapEntry))!=h.checksum){
+		cout << "Scifi: corrupted SiPM map cache "<<fname<<", recomputing"<<endl;
+		return kFALSE;
+	}
+	for (auto& e : entries){fibresSiPM[e.sipm][e.fibre] = {e.weight, e.pos};}
+	return kTRUE;
+}
+void Scifi::WriteSiPMmap(ULong64_t geoHash)
+{
+	TString fname = SiPMmapFile(geoHash);
+	gSystem->mkdir(gSystem->DirName(fname), kTRUE);
+	std::vector<SiPMmapEntry> entries;
+	for (auto& c : fibresSiPM){
+		for (auto& f : c.second){entries.push_back({c.first, f.first, f.second[0], f.second[1]});}
+	}
+	SiPMmapHeader h{};
+	memcpy(h.magic, kSiPMmapMagic, sizeof(h.magic));
+	h.geoHash = geoHash;
+	h.n = entries.size();
+	h.checksum = fnv1a(entries.data(), entries.size()*sizeof(SiPMmapEntry));
+  // write to a private file and rename, concurrent jobs never see a partial map
+	TString tmpName = Form("%s.%d", fname.Data(), gSystem->GetPid());
+	std::ofstream out(tmpName.Data(), std::ios::binary);
+	out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+	out.write(reinterpret_cast<const char*>(entries.data()), entries.size()*sizeof(SiPMmapEntry));
+	out.close();
+	if (!out || rename(tmpName.Data(), fname.Data())!=0){
+		cout << "Scifi: could not write SiPM map cache "<<fname<<endl;
+		gSystem->Unlink(tmpName);
+	}
 }
 void Scifi::EndOfEvent()
 {
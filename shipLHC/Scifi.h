@@ -8,6 +8,11 @@
 #include "Rtypes.h"                     // for ShipMuonShield::Class, Bool_t, etc
 
 #include <string>                       // for string
+#include <map>
+#include <array>
+#include <vector>
+#include <atomic>
+#include <mutex>
 
 #include "TVector3.h"
 #include "TLorentzVector.h"
@@ -33,19 +38,33 @@ public:
     TVector3 GetLocalPos(Int_t id, TVector3* glob);
     /** mean position of fibre2 associated with SiPM channel **/
     void GetSiPMPosition(Int_t SiPMChan, TVector3& A, TVector3& B) ;
+    /** Both positions are read from a per-channel cache, built on first use and again after
+        SetConfPar changed the alignment. Lookups may run in several threads, but not
+        concurrently with SetConfPar **/
+    void BuildPositionCache();
     Double_t GetCorrectedTime(Int_t fDetectorID, Double_t rawTime, Double_t L);
     Double_t ycross(Double_t a,Double_t R,Double_t x);
     Double_t integralSqrt(Double_t ynorm);
     Double_t fraction(Double_t R,Double_t x,Double_t y);
     Double_t area(Double_t a,Double_t R,Double_t xL,Double_t xR);
+    /** Fibre to SiPM channel mapping, read from the cache next to the geometry if it was already computed **/
     void SiPMmapping();
-    std::map<Int_t,std::map<Int_t,std::array<float, 2>>> GetSiPMmap(){return fibresSiPM;}
-    std::map<Int_t,std::map<Int_t,std::array<float, 2>>> GetFibresMap(){return siPMFibres;}
-    std::map<Int_t,float> GetSiPMPos(){return SiPMPos;}
+    void SetSiPMmapDir(TString dir){fSiPMmapDir = dir;}
+    const std::map<Int_t,std::map<Int_t,std::array<float, 2>>>& GetSiPMmap(){return fibresSiPM;}
+    const std::map<Int_t,std::map<Int_t,std::array<float, 2>>>& GetFibresMap(){return siPMFibres;}
+    const std::map<Int_t,float>& GetSiPMPos(){return SiPMPos;}
+    /** SiPM channels and weights of local fibre fID, returns their number **/
+    Int_t GetFibreSiPMs(Int_t fID, const Int_t*& sipm, const Float_t*& weight) const
+    {
+      if (fID < 0 || fID+1 >= (Int_t)fFibreOffset.size()) return 0;
+      sipm = fFibreSiPM.data() + fFibreOffset[fID];
+      weight = fFibreWeight.data() + fFibreOffset[fID];
+      return fFibreOffset[fID+1] - fFibreOffset[fID];
+    }
     virtual void SiPMOverlap();
-    void SetConfPar(TString name, Float_t value){conf_floats[name]=value;}
-    void SetConfPar(TString name, Int_t value){conf_ints[name]=value;}
-    void SetConfPar(TString name, TString value){conf_strings[name]=value;}
+    void SetConfPar(TString name, Float_t value){conf_floats[name]=value; fPosCacheValid = false;}
+    void SetConfPar(TString name, Int_t value){conf_ints[name]=value; fPosCacheValid = false;}
+    void SetConfPar(TString name, TString value){conf_strings[name]=value; fPosCacheValid = false;}
     Float_t  GetConfParF(TString name){return conf_floats[name];} 
     Int_t       GetConfParI(TString name){return conf_ints[name];}
     TString  GetConfParS(TString name){return conf_strings[name];}
@@ -111,6 +130,33 @@ private:
     std::map<Int_t,std::map<Int_t,std::array<float, 2>>> fibresSiPM;  //! mapping of fibres to SiPM channels
     std::map<Int_t,std::map<Int_t,std::array<float, 2>>> siPMFibres;  //! inverse mapping
     std::map<Int_t,float> SiPMPos;  //! local SiPM channel position
+    std::vector<Int_t> fFibreOffset;  //! flat inverse mapping, offsets per fibre
+    std::vector<Int_t> fFibreSiPM;    //! SiPM channels
+    std::vector<Float_t> fFibreWeight;  //! and their weights
+    TString fSiPMmapDir;  //! directory of the cached mapping
+    /** Global endpoints A and B of fibres or SiPM channels, densely indexed by their STMRFFF digits **/
+    struct ChannelEnds
+    {
+      Int_t lo[5]{}, n[5]{};   // first value and range of S, T, M, R and FFF
+      std::vector<Double_t> fEnds;
+      std::vector<char> fFilled;
+      static void Split(Int_t id, Int_t* d)
+      {
+        d[0] = id/1000000; d[1] = (id/100000)%10; d[2] = (id/10000)%10; d[3] = (id/1000)%10; d[4] = id%1000;
+      }
+      void Fill(const std::vector<Int_t>& ids, const std::vector<Double_t>& ends);
+      Int_t Index(Int_t id) const;
+      Bool_t Get(Int_t id, TVector3& A, TVector3& B) const;
+    };
+    ChannelEnds fFibreEnds;  //!
+    ChannelEnds fSiPMEnds;   //!
+    std::atomic<bool> fPosCacheValid{false};  //!
+    std::mutex fPosCacheMutex;  //!
+    void GetPositionFromGeo(Int_t id, TVector3& A, TVector3& B);
+    void GetSiPMPositionFromGeo(Int_t SiPMChan, TVector3& A, TVector3& B);
+    TString SiPMmapFile(ULong64_t geoHash);
+    Bool_t ReadSiPMmap(ULong64_t geoHash);
+    void WriteSiPMmap(ULong64_t geoHash);
     /** container for data points */
     TClonesArray*  fScifiPointCollection;
     /** configuration parameters **/
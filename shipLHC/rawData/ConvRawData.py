@@ -89,7 +89,11 @@ class ConvRawDataPY(ROOT.FairTask):
       ioman.RegisterInputObject("rawData", self.fiN)
 
   # Set output
+      self.nThreads = getattr(options, 'nThreads', 1)
       if self.monitoring:  self.outfile = ROOT.FairRootFileSink(self.outFile)
+      elif options.FairTask_convRaw and self.nThreads>1:
+           # the parallel conversion writes its own output file, FairRoot only needs a sink
+           self.outfile = ROOT.FairRootFileSink(ROOT.TMemFile('convRawSink', 'recreate'))
       elif options.FairTask_convRaw: self.outfile = ROOT.FairRootFileSink(self.outFile.replace('.root','_CPP.root'))
       else:  self.outfile = ROOT.FairRootFileSink(self.outFile)
       self.run.SetSink(self.outfile)
@@ -346,7 +350,11 @@ class ConvRawDataPY(ROOT.FairTask):
   # v_fine = 0-1023, QDC mode: represents the charge measured. Requires calibration.
 
    def Run(self):
-      if self.options.FairTask_convRaw:
+      if self.options.FairTask_convRaw and self.nThreads>1:
+          if not self.run.GetTask("ConvRawData").RunParallel(self.nThreads, self.outFile.replace('.root','_CPP.root')):
+             print('parallel conversion failed, no output written. Stop')
+             sys.exit(1)
+      elif self.options.FairTask_convRaw:
           self.run.Run(self.options.nStart, self.nEvents)
       else:
           for eventNumber in range(self.options.nStart,self.nEvents):
@@ -622,7 +630,9 @@ class ConvRawDataPY(ROOT.FairTask):
 
 
    def Finalize(self):
-      if self.options.FairTask_convRaw:
+      if self.options.FairTask_convRaw and self.nThreads>1:
+          self.fiN.Close()
+      elif self.options.FairTask_convRaw:
   # overwrite cbmsim 
           F = self.outfile.GetRootFile()
           T = F.Get("cbmsim")
@@ -289,7 +289,10 @@ class Monitoring():
             if self.MonteCarlo: self.Weight = self.eventTree.MCTrack[0].GetWeight()
             for t in self.FairTasks: self.FairTasks[t].ExecuteTask()
       self.EventNumber = n
+      self.checkBunchXing()
+      return self.eventTree
 
+   def checkBunchXing(self):
 # check for bunch xing type
       self.xing = {'all':True,'B1only':False,'B2noB1':False,'noBeam':False}
       if self.fsdict:
@@ -315,7 +318,32 @@ class Monitoring():
              if self.xing['B1only']  and self.xing['B2noB1']  or self.xing['B1only'] and self.xing['noBeam'] : print('error with b1only assignment',self.xing)
              if self.xing['B2noB1']  and self.xing['noBeam'] : print('error with b2nob1 assignment',self.xing)
 
-      return self.eventTree
+   def Follow(self,monitorTasks,nStart,N0,idleTimeout=10):
+   # auto mode with the ConvRawData FairTask: the task converts the events while the DAQ writes them,
+   # continuing with the next partitions, and calls back here to run the tracking and monitor tasks.
+   # Returns the updated event count N0 after idleTimeout seconds without new events.
+   # Followed events are not written to the output file.
+      convTask = self.converter.run.GetTask("ConvRawData")
+      self.eventTree = self.converter.fSink.GetOutTree()
+      self.nFollowed = N0
+      def processEvent(n):
+         self.Reco_MuonTracks.Delete()
+         for t in self.FairTasks: self.FairTasks[t].ExecuteTask()
+         self.EventNumber = n
+         self.checkBunchXing()
+         for m in monitorTasks:
+            monitorTasks[m].ExecuteEvent(self.eventTree)
+         self.nFollowed+=1
+# update plots
+         if self.nFollowed%self.options.Nupdate==0 or self.nFollowed==int(self.options.Nupdate/10):
+            for m in monitorTasks:
+               monitorTasks[m].Plot()
+            if self.options.sudo: self.publishRootFile()
+      self.followCallback = processEvent  # keep alive while the task holds it
+      if nStart>=0: convTask.UpdateInput(nStart)
+      convTask.SetEventCallback(self.followCallback)
+      convTask.Follow(500,idleTimeout)
+      return self.nFollowed
 
    def publishRootFile(self):
    # try to copy root file with TCanvas to EOS
@@ -264,6 +264,25 @@ else:
      lastRun  = tmp[len(tmp)-2].replace('monitoring_','')
      lastPart = tmp[len(tmp)-1]
 
+   if options.FairTask_convRaw:
+   # the ConvRawData task follows the file and the next partitions itself,
+   # it returns after 10 seconds without new events to check for the end of the run
+      while 1>0:
+         N0 = M.Follow(monitorTasks,nStart,N0)
+         nStart = -1
+         curRun,curPart,options.startTime  =  currentRun()
+         while curRun.find('run') < 0:
+               curRun,curPart,options.startTime  =  currentRun()
+               if curRun.find('run') < 0:  
+                   print("sleep 300sec.",curRun,time.ctime())
+                   time.sleep(300)
+         if not curRun == lastRun:
+            for m in monitorTasks:
+               if not options.interactive:  monitorTasks[m].Plot()
+            print("run ",lastRun," has finished.")
+            quit()  # reinitialize everything with new run number
+         print('DAQ inactive for 10sec. Events = ',N0, curRun,curPart)
+
    M.updateSource(lastFile)
    while 1>0:
       for n in range(nStart,nLast):
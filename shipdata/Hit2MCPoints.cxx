@@ -1,22 +1,92 @@
 #include "Hit2MCPoints.h"
 #include <stdio.h>
+#include <algorithm>
 
 // -----   Default constructor   -------------------------------------------
 Hit2MCPoints::Hit2MCPoints()
-  : TObject()
+  : TObject(),
+   fDetIDs(), fOffsets(1, 0), fPoints(), fWeights()
 {
 }
 
 // -----   Fill   ------------------------------------------
 void Hit2MCPoints::Add(int detID,int key, float w)
 {
-       linksToMCPoints[detID][key]=w;
+   if (fOffsets.empty()) fOffsets.push_back(0);
+   // new last detector element, the usual case when filling in detID order
+   if (fDetIDs.empty() || fDetIDs.back() < detID) {
+       fDetIDs.push_back(detID);
+       fOffsets.push_back(fOffsets.back());
+   }
+   auto it = std::lower_bound(fDetIDs.begin(), fDetIDs.end(), detID);
+   size_t row = it - fDetIDs.begin();
+   if (*it != detID) {
+       // detector element out of order, open an empty row in the middle
+       fDetIDs.insert(it, detID);
+       fOffsets.insert(fOffsets.begin()+row+1, fOffsets[row]);
+   }
+   unsigned int begin = fOffsets[row], end = fOffsets[row+1];
+   for (unsigned int i = begin; i < end; i++) {
+       if (fPoints[i] == key) {
+           fWeights[i] = w;
+           return;
+       }
+   }
+   fPoints.insert(fPoints.begin()+end, key);
+   fWeights.insert(fWeights.begin()+end, w);
+   for (size_t r = row+1; r < fOffsets.size(); r++) fOffsets[r]++;
+}
+
+// -----   Fill from the version 1 layout   --------------------------------
+void Hit2MCPoints::SetLinks(const std::unordered_map<int,std::unordered_map<int,float>>& links)
+{
+   fDetIDs.clear();
+   fPoints.clear();
+   fWeights.clear();
+   for (auto& l : links) fDetIDs.push_back(l.first);
+   std::sort(fDetIDs.begin(), fDetIDs.end());
+   fOffsets.assign(1, 0);
+   std::vector<std::pair<int,float>> row;
+   for (int detID : fDetIDs) {
+       const std::unordered_map<int,float>& points = links.at(detID);
+       row.assign(points.begin(), points.end());
+       std::sort(row.begin(), row.end());
+       for (auto& p : row) {
+           fPoints.push_back(p.first);
+           fWeights.push_back(p.second);
+       }
+       fOffsets.push_back(fPoints.size());
+   }
+}
+
+// -----   Accessors   -----------------------------------------------------
+Hit2MCPoints::LinkSpan Hit2MCPoints::links(int detID) const
+{
+   LinkSpan span = {nullptr, nullptr, 0};
+   auto it = std::lower_bound(fDetIDs.begin(), fDetIDs.end(), detID);
+   if (it == fDetIDs.end() || *it != detID) return span;
+   size_t row = it - fDetIDs.begin();
+   span.points = fPoints.data() + fOffsets[row];
+   span.weights = fWeights.data() + fOffsets[row];
+   span.n = fOffsets[row+1] - fOffsets[row];
+   return span;
+}
+
+std::unordered_map<int,float> Hit2MCPoints::wList(int detID) const
+{
+   std::unordered_map<int,float> result;
+   LinkSpan span = links(detID);
+   for (unsigned int i = 0; i < span.n; i++) result[span.points[i]] = span.weights[i];
+   return result;
 }
 
 // -----   Copy constructor   ----------------------------------------------
 Hit2MCPoints::Hit2MCPoints(const Hit2MCPoints& ti)
   : TObject(ti),
-   linksToMCPoints(ti.linksToMCPoints)
+   fDetIDs(ti.fDetIDs),
+   fOffsets(ti.fOffsets),
+   fPoints(ti.fPoints),
+   fWeights(ti.fWeights)
 {
 }
 // -----   Destructor   ----------------------------------------------------
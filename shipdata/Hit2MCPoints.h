@@ -4,10 +4,12 @@
 #include "TObject.h"              //  
 #include "Rtypes.h"                     // for Double_t, Int_t, Double32_t, etc
 #include <unordered_map>
+#include <vector>
 
 #ifndef __CINT__
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/base_object.hpp>
+#include <boost/serialization/vector.hpp>
 #endif //__CINT__
 
 class Hit2MCPoints : public TObject
@@ -15,20 +17,40 @@ class Hit2MCPoints : public TObject
 
   public:
 
+    /** View of the MC points linked to one detector element, pointing into
+        the storage of the Hit2MCPoints object. Valid until the next Add. **/
+    struct LinkSpan
+    {
+        const int* points;
+        const float* weights;
+        unsigned int n;
+        unsigned int size() const {return n;}
+        int point(unsigned int i) const {return points[i];}
+        float weight(unsigned int i) const {return weights[i];}
+    };
+
     /** Default constructor **/
     Hit2MCPoints();
 
     /**  Copy constructor  **/
     Hit2MCPoints(const Hit2MCPoints& ti);
 
+    /** Link MC point key to detector element detID with weight w. Adding
+        detIDs in ascending order is cheapest. **/
     void Add(int detID,int key, float w);
 
+    /** Replace all links, used for reading class version 1 **/
+    void SetLinks(const std::unordered_map<int,std::unordered_map<int,float>>& links);
+
     /** Destructor **/
     virtual ~Hit2MCPoints();
 
     /** Accessors **/
-    unsigned int N(int detID){return linksToMCPoints[detID].size();}
-    std::unordered_map<int,float> wList(int detID){return linksToMCPoints[detID];}
+    unsigned int N(int detID) const {return links(detID).n;}
+    LinkSpan links(int detID) const;
+    std::unordered_map<int,float> wList(int detID) const;
+    unsigned int NDetIDs() const {return fDetIDs.size();}
+    int detID(unsigned int n) const {return fDetIDs[n];}
 
     /*** Output to screen */
     virtual void Print(const Option_t* opt ="") const {;}
@@ -37,15 +59,23 @@ class Hit2MCPoints : public TObject
     void serialize(Archive& ar, const unsigned int version)
     {
         ar& boost::serialization::base_object<TObject>(*this);
-        ar& linksToMCPoints;
+        ar& fDetIDs;
+        ar& fOffsets;
+        ar& fPoints;
+        ar& fWeights;
     }
 
   protected:
 #ifndef __CINT__ // for BOOST serialization
     friend class boost::serialization::access;
 #endif // for BOOST serialization
-    std::unordered_map<int,std::unordered_map<int,float>>  linksToMCPoints;  ///< array of detector elements with list of contributing MCPoints
-    ClassDef(Hit2MCPoints,1);
+    /** Links in compressed sparse row layout: the MC points of detector
+        element fDetIDs[i] are fPoints[fOffsets[i]..fOffsets[i+1]) **/
+    std::vector<int> fDetIDs;            ///< detector elements, ascending
+    std::vector<unsigned int> fOffsets;  ///< row offsets, size fDetIDs.size()+1
+    std::vector<int> fPoints;            ///< contributing MCPoints
+    std::vector<float> fWeights;         ///< weights of contributing MCPoints
+    ClassDef(Hit2MCPoints,2);
 };
 
 #endif
@@ -12,5 +12,10 @@
 #pragma link C++ class ShipParticle+;
 #pragma link C++ class TrackInfo+;
 #pragma link C++ class Hit2MCPoints+;
+// version 1 kept the links in nested unordered_maps
+#pragma read sourceClass="Hit2MCPoints" targetClass="Hit2MCPoints" version="[1]" \
+  source="std::unordered_map<int,std::unordered_map<int,float> > linksToMCPoints" \
+  target="fDetIDs,fOffsets,fPoints,fWeights" \
+  code="{ newObj->SetLinks(onfile.linksToMCPoints); }"
 #endif
 
@@ -18,11 +18,11 @@
 #include "TRefArray.h"                  // for TRefArray
 
 #include <stddef.h>                     // for NULL
+#include <algorithm>                    // for max
 #include <iostream>                     // for operator<<, etc
 
 using std::cout;
 using std::endl;
-using std::pair;
 
 
 // -----   Default constructor   -------------------------------------------
@@ -32,9 +32,7 @@ ShipStack::ShipStack(Int_t size)
     fParticles(new TClonesArray("TParticle", size)),
     fTracks(new TClonesArray("ShipMCTrack", size)),
     fStoreMap(),
-    fStoreIter(),
     fIndexMap(),
-    fIndexIter(),
     fPointsMap(),
     fCurrentTrack(-1),
     fNPrimaries(0),
@@ -226,8 +224,10 @@ void ShipStack::FillTrackArray()
 
   LOG(DEBUG) << "ShipStack: Filling MCTrack array...";
 
-  // --> Reset index map and number of output tracks
-  fIndexMap.clear();
+  // --> Reset index map and number of output tracks, entry 0 maps the
+  //     mother index -1 of primary mothers
+  fIndexMap.assign(fNParticles + 1, -2);
+  fIndexMap[0] = -1;
   fNTracks = 0;
 
   // --> Check tracks for selection criteria
@@ -236,29 +236,19 @@ void ShipStack::FillTrackArray()
   // --> Loop over fParticles array and copy selected tracks
   for (Int_t iPart=0; iPart<fNParticles; iPart++) {
 
-    fStoreIter = fStoreMap.find(iPart);
-    if (fStoreIter == fStoreMap.end() ) {
-      LOGF(fatal, "ShipStack: Particle %i not found in storage map! ", iPart);
-    }
-    Bool_t store = (*fStoreIter).second;
-
-    if (store) {
+    if (fStoreMap[iPart]) {
       ShipMCTrack* track =
         new( (*fTracks)[fNTracks]) ShipMCTrack(GetParticle(iPart));
-      fIndexMap[iPart] = fNTracks;
+      fIndexMap[iPart + 1] = fNTracks;
       // --> Set the number of points in the detectors for this track
       for (Int_t iDet=kVETO; iDet<kEndOfList; iDet++) {
-        pair<Int_t, Int_t> a(iPart, iDet);
-        track->SetNPoints(iDet, fPointsMap[a]);
+        track->SetNPoints(iDet, GetNPoints(iPart, iDet));
       }
       fNTracks++;
-    } else { fIndexMap[iPart] = -2; }
+    }
 
   }
 
-  // --> Map index for primary mothers
-  fIndexMap[-1] = -1;
-
   // --> Screen output
   //Print(1);
 
@@ -278,11 +268,7 @@ void ShipStack::UpdateTrackIndex(TRefArray* detList)
   for (Int_t i=0; i<fNTracks; i++) {
     ShipMCTrack* track = (ShipMCTrack*)fTracks->At(i);
     Int_t iMotherOld = track->GetMotherId();
-    fIndexIter = fIndexMap.find(iMotherOld);
-    if (fIndexIter == fIndexMap.end()) {
-      LOGF(fatal, "ShipStack: Particle index %i not found in dex map! ", iMotherOld);
-    }
-    track->SetMotherId( (*fIndexIter).second );
+    track->SetMotherId( GetTrackIndex(iMotherOld) );
   }
 
 
@@ -308,14 +294,9 @@ void ShipStack::UpdateTrackIndex(TRefArray* detList)
       // --> Update track index for all MCPoints in the collection
       for (Int_t iPoint=0; iPoint<nPoints; iPoint++) {
         FairMCPoint* point = (FairMCPoint*)hitArray->At(iPoint);
-        Int_t iTrack = point->GetTrackID();
-
-        fIndexIter = fIndexMap.find(iTrack);
-        if (fIndexIter == fIndexMap.end()) {
-          LOGF(fatal, "ShipStack: Particle index %i not found in index map! ", iTrack);
-        }
-        point->SetTrackID((*fIndexIter).second);
-        point->SetLink(FairLink("MCTrack", (*fIndexIter).second));
+        Int_t iTrack = GetTrackIndex(point->GetTrackID());
+        point->SetTrackID(iTrack);
+        point->SetLink(FairLink("MCTrack", iTrack));
       }
 
     }   // Collections of this detector
@@ -335,7 +316,7 @@ void ShipStack::Reset()
   while (! fStack.empty() ) { fStack.pop(); }
   fParticles->Clear();
   fTracks->Clear();
-  fPointsMap.clear();
+  fPointsMap.assign(fPointsMap.size(), 0);
 }
 // -------------------------------------------------------------------------
 
@@ -372,11 +353,8 @@ void ShipStack::Print(Int_t iVerbose) const
 // -----   Public method AddPoint (for current track)   --------------------
 void ShipStack::AddPoint(DetectorId detId)
 {
-  Int_t iDet = detId;
-// cout << "Add point for Detektor" << iDet << endl;
-  pair<Int_t, Int_t> a(fCurrentTrack, iDet);
-  if ( fPointsMap.find(a) == fPointsMap.end() ) { fPointsMap[a] = 1; }
-  else { fPointsMap[a]++; }
+// cout << "Add point for Detektor" << detId << endl;
+  AddPoint(detId, fCurrentTrack);
 }
 // -------------------------------------------------------------------------
 
@@ -386,10 +364,12 @@ void ShipStack::AddPoint(DetectorId detId)
 void ShipStack::AddPoint(DetectorId detId, Int_t iTrack)
 {
   if ( iTrack < 0 ) { return; }
-  Int_t iDet = detId;
-  pair<Int_t, Int_t> a(iTrack, iDet);
-  if ( fPointsMap.find(a) == fPointsMap.end() ) { fPointsMap[a] = 1; }
-  else { fPointsMap[a]++; }
+  size_t i = size_t(iTrack)*kEndOfList + detId;
+  if ( i >= fPointsMap.size() ) {
+    // grow geometrically, particles are added one by one during transport
+    fPointsMap.resize(std::max(2*fPointsMap.size(), size_t(iTrack+1)*kEndOfList), 0);
+  }
+  fPointsMap[i]++;
 }
 // -------------------------------------------------------------------------
 
@@ -419,12 +399,24 @@ TParticle* ShipStack::GetParticle(Int_t trackID) const
 
 
 
+// -----   Private method GetTrackIndex   ----------------------------------
+Int_t ShipStack::GetTrackIndex(Int_t iPart) const
+{
+  if (iPart < -1 || iPart + 1 >= Int_t(fIndexMap.size())) {
+    LOGF(fatal, "ShipStack: Particle index %i not found in index map! ", iPart);
+  }
+  return fIndexMap[iPart + 1];
+}
+// -------------------------------------------------------------------------
+
+
+
 // -----   Private method SelectTracks   -----------------------------------
 void ShipStack::SelectTracks()
 {
 
-  // --> Clear storage map
-  fStoreMap.clear();
+  // --> Reset storage flags
+  fStoreMap.assign(fNParticles, kTRUE);
 
   // --> Check particles in the fParticle array
   for (Int_t i=0; i<fNParticles; i++) {
@@ -444,10 +436,7 @@ void ShipStack::SelectTracks()
     // --> Calculate number of points
     Int_t nPoints = 0;
     for (Int_t iDet=kVETO; iDet<kEndOfList; iDet++) {
-      pair<Int_t, Int_t> a(i, iDet);
-      if ( fPointsMap.find(a) != fPointsMap.end() ) {
-        nPoints += fPointsMap[a];
-      }
+      nPoints += GetNPoints(i, iDet);
     }
 
     // --> Check for cuts (store primaries in any case)
@@ -467,16 +456,21 @@ void ShipStack::SelectTracks()
 // doesn't work, always true: Int_t iMother2 = GetParticle(i)->GetMother(1); maybe should set Mother2 to -1 in the generator
 // if (iMother == iMother2) {fStoreMap[i] = kTRUE;}
   }
-  // --> If flag is set, flag recursively mothers of selected tracks
+  // --> If flag is set, flag recursively mothers of selected tracks.
+  //     A mother whose ancestors were already flagged ends the walk.
   if (fStoreMothers) {
+    std::vector<Bool_t> ancestorsDone(fNParticles, kFALSE);
     for (Int_t i=0; i<fNParticles; i++) {
       if (fStoreMap[i]) {
         Int_t iMother  = GetParticle(i)->GetMother(0);
 	{
           while(iMother >= 0)
 	  {
+            TParticle* mother = GetParticle(iMother);
+            if (ancestorsDone[iMother]) { break; }
+            ancestorsDone[iMother] = kTRUE;
             fStoreMap[iMother] = kTRUE;
-            iMother = GetParticle(iMother)->GetMother(0);
+            iMother = mother->GetMother(0);
           }
        }
       }
@@ -32,9 +32,8 @@
 #include "Rtypes.h"                     // for Int_t, Double_t, Bool_t, etc
 #include "TMCProcess.h"                 // for TMCProcess
 
-#include <map>                          // for map, map<>::iterator
 #include <stack>                        // for stack
-#include <utility>                      // for pair
+#include <vector>                       // for vector
 
 class TClonesArray;
 class TParticle;
@@ -211,18 +210,20 @@ class ShipStack : public FairGenericStack
     TClonesArray* fTracks;
 
 
-    /** STL map from particle index to storage flag  **/
-    std::map<Int_t, Bool_t>           fStoreMap;        //!
-    std::map<Int_t, Bool_t>::iterator fStoreIter;       //!
+    /** Storage flag of each particle, indexed by particle index  **/
+    std::vector<Bool_t>               fStoreMap;        //!
 
 
-    /** STL map from particle index to track index  **/
-    std::map<Int_t, Int_t>            fIndexMap;        //!
-    std::map<Int_t, Int_t>::iterator  fIndexIter;       //!
+    /** Track index of each particle, indexed by particle index + 1,
+     ** the first entry maps the mother index -1 of primaries
+     **/
+    std::vector<Int_t>                fIndexMap;        //!
 
 
-    /** STL map from track index and detector ID to number of MCPoints **/
-    std::map<std::pair<Int_t, Int_t>, Int_t> fPointsMap;     //!
+    /** Number of MCPoints per particle and detector, the entries of
+     ** particle i are [i*kEndOfList, (i+1)*kEndOfList)
+     **/
+    std::vector<Int_t>                fPointsMap;       //!
 
 
     /** Some indizes and counters **/
@@ -243,6 +244,18 @@ class ShipStack : public FairGenericStack
     /** Mark tracks for output using selection criteria  **/
     void SelectTracks();
 
+
+    /** Output track index of a particle, fatal if it is not mapped **/
+    Int_t GetTrackIndex(Int_t iPart) const;
+
+
+    /** Number of MCPoints of a particle in a detector **/
+    Int_t GetNPoints(Int_t iPart, Int_t iDet) const
+    {
+      size_t i = size_t(iPart)*kEndOfList + iDet;
+      return i < fPointsMap.size() ? fPointsMap[i] : 0;
+    }
+
     ShipStack(const ShipStack&);
     ShipStack& operator=(const ShipStack&);
 
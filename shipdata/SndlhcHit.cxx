@@ -33,6 +33,13 @@ Float_t SndlhcHit::GetTime(Int_t nChannel)
 {
  return times[nChannel];
 }
+Int_t SndlhcHit::Compare(const TObject* obj) const
+{
+ Int_t other = static_cast<const SndlhcHit*>(obj)->GetDetectorID();
+ if (fDetectorID < other) return -1;
+ if (fDetectorID > other) return 1;
+ return 0;
+}
 // -------------------------------------------------------------------------
 
 
@@ -45,6 +45,9 @@ class SndlhcHit : public TObject
     Int_t GetBoardID(Int_t i) { return int(fDaqID[i]/1000);}
     Int_t GetTofpetID(Int_t i) { return int((fDaqID[i]%1000)/100);}
     Int_t Getchannel(Int_t i) { return fDaqID[i]%100;}
+    /** Hits are ordered by detector ID, e.g. for TClonesArray::Sort **/
+    Bool_t IsSortable() const { return kTRUE; }
+    Int_t Compare(const TObject* obj) const;
 
 // to be implemented by the subdetector
 
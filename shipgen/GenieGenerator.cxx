@@ -4,8 +4,7 @@
 #include "TMath.h"
 #include "TFile.h"
 #include "TRandom.h"
-#include "TCut.h"
-#include "TEventList.h"
+#include "TBranch.h"
 #include "FairPrimaryGenerator.h"
 #include "GenieGenerator.h"
 #include "TGeoVolume.h"
@@ -15,6 +14,8 @@
 #include "TGeoCompositeShape.h"
 #include "TParticle.h"
 #include "TClonesArray.h"
+#include <algorithm>
+#include <cmath>
 
 using std::cout;
 using std::endl;
@@ -102,6 +103,7 @@ Bool_t GenieGenerator::Init(const char* fileName, const int firstEvent) {
    fFLUKANuTree->SetBranchAddress("Ancstr",&ancstr);
    fDeltaE_GenieFLUKA_nu = 10.; //Default value for energy range of FLUKA->Genie matching, 10 GeV.
   }
+  if (fGenOption == 1 || fGenOption == 2) BuildEnergyIndex();
   fFirst=kTRUE;
   return kTRUE;
 }
@@ -143,6 +145,9 @@ Double_t GenieGenerator::MeanMaterialBudget(const Double_t *start, const Double_
 
   for (Int_t i=0;i<7;i++) bparam[i]=0;
 
+  fProfileLength.clear();
+  fProfileDensity.clear();
+
   if (!gGeoManager) {
     //AliFatalClass("No TGeo\n");
     return 0.;
@@ -198,6 +203,8 @@ Double_t GenieGenerator::MeanMaterialBudget(const Double_t *start, const Double_
   Double_t snext = gGeoManager->GetStep();
   // If no boundary within proposed length, return current density
   if (!gGeoManager->IsOnBoundary()) {
+    fProfileLength.push_back(lparam[4]);
+    fProfileDensity.push_back(lparam[0]);
     mparam[0] = lparam[0];
     mparam[1] = lparam[4]/lparam[1];
     mparam[2] = lparam[2];
@@ -225,6 +232,8 @@ Double_t GenieGenerator::MeanMaterialBudget(const Double_t *start, const Double_
       mparam[4] = step;
       mparam[0] = 0.;             // if crash of navigation take mean density 0
       mparam[1] = 1000000;        // and infinite rad length
+      fProfileLength.clear();     // and no density profile
+      fProfileDensity.clear();
       return bparam[0]/step;
     }
     mparam[6]+=1.;
@@ -235,6 +244,8 @@ Double_t GenieGenerator::MeanMaterialBudget(const Double_t *start, const Double_
     bparam[5]    += snext*lparam[5];
     bparam[6]    += snext/lparam[6];
     bparam[0]    += snext*lparam[0];
+    fProfileLength.push_back(snext);
+    fProfileDensity.push_back(lparam[0]);
 
     if (snext>=length) break;
     if (!currentnode) break;
@@ -272,6 +283,36 @@ Double_t GenieGenerator::MeanMaterialBudget(const Double_t *start, const Double_
   return bparam[0]/step;
 }
 
+Bool_t GenieGenerator::SampleInteractionZ(const Double_t *start, const Double_t *end, Double_t &z)
+{
+  // Pick the interaction point along the straight line start-end with a
+  // probability proportional to the local density, by inverting the
+  // cumulative density of the segments recorded by the last call to
+  // MeanMaterialBudget(start, end, ...). Returns kFALSE if that walk gave
+  // no usable profile.
+  Double_t total = 0.;
+  for (size_t i=0; i<fProfileLength.size(); i++) total += fProfileLength[i]*fProfileDensity[i];
+  if (!(total > 0.)) return kFALSE;
+
+  Double_t length = TMath::Sqrt((end[0]-start[0])*(end[0]-start[0])+
+                                (end[1]-start[1])*(end[1]-start[1])+
+                                (end[2]-start[2])*(end[2]-start[2]));
+  Double_t u = gRandom->Uniform(0.,total);
+  Double_t path = 0.;
+  for (size_t i=0; i<fProfileLength.size(); i++) {
+    Double_t w = fProfileLength[i]*fProfileDensity[i];
+    if (u < w || i+1 == fProfileLength.size()) {
+      path += fProfileDensity[i] > 0. ? TMath::Min(u/fProfileDensity[i], fProfileLength[i]) : 0.;
+      break;
+    }
+    u -= w;
+    path += fProfileLength[i];
+  }
+  if (path > length) path = length;
+  z = start[2] + (end[2]-start[2])*path/length;
+  return kTRUE;
+}
+
 std::vector<double> GenieGenerator::Rotate(Double_t x, Double_t y, Double_t z, Double_t px, Double_t py, Double_t pz)
 {
   //rotate vector px,py,pz to point at x,y,z at origin.
@@ -295,20 +336,40 @@ std::vector<double> GenieGenerator::Rotate(Double_t x, Double_t y, Double_t z, D
   return pout;
 }
 
+void GenieGenerator::BuildEnergyIndex(){
+
+  // Read only the pzv branch once and sort the GENIE entries by it, so
+  // matching an energy window does not need a pass over the whole tree
+  fPzvIndex.clear();
+  fPzvIndex.reserve(fTree->GetEntries());
+  TBranch* pzvBranch = fTree->GetBranch("pzv");
+  for (Long64_t i = 0; i < fTree->GetEntries(); i++){
+    pzvBranch->GetEntry(i);
+    if (std::isnan(pzv)) continue; // never selected by a pzv window
+    fPzvIndex.push_back(std::make_pair(pzv, Int_t(i)));
+  }
+  std::sort(fPzvIndex.begin(), fPzvIndex.end());
+  LOGF(info, "GenieGenerator: energy index of %zu GENIE events built", fPzvIndex.size());
+}
+
 Int_t GenieGenerator::ExtractEvent_Ekin(Double_t Ekin, Double_t DeltaE){
 
-  //TCut nucut(Form("Ekin >= (%f - %f) && Ekin < (%f + %f)",Ekin,DeltaE/2., Ekin, DeltaE/2.));
-  //fFLUKANuTree->Draw(">>nulist", nucut );
-  TCut nucut(Form("pzv >= (%f - %f) && pzv < (%f + %f)",Ekin,DeltaE/2., Ekin, DeltaE/2.));
-  fTree->Draw(">>nulist",nucut);
-
-  TEventList *nulist = (TEventList*)gDirectory->GetList()->FindObject("nulist");
-  Int_t nselectedevents = nulist->GetN();
-  //integer function returns randomly integer between 0 e nselectedevents;
-  Int_t myevent = nulist->GetEntry(gRandom->Integer(nselectedevents+1));
- 
-  nulist->Reset(); //resetting list for next call of the function.
-  return myevent;
+  // GENIE entries with Ekin - DeltaE/2 <= pzv < Ekin + DeltaE/2, from the sorted energy index
+  std::pair<Double_t,Int_t> lo(Ekin - DeltaE/2., -1), hi(Ekin + DeltaE/2., -1);
+  auto first = std::lower_bound(fPzvIndex.cbegin(), fPzvIndex.cend(), lo);
+  auto last  = std::lower_bound(first, fPzvIndex.cend(), hi);
+  Int_t nselectedevents = last - first;
+
+  // Same pick as from the TEventList of the former fTree->Draw selection: the
+  // selected entries in tree order, an integer between 0 and nselectedevents,
+  // where nselectedevents itself is past the end of the list and gives -1
+  Int_t ipick = gRandom->Integer(nselectedevents+1);
+  if (ipick >= nselectedevents) return -1;
+
+  fPzvSelected.clear();
+  for (; first != last; ++first) fPzvSelected.push_back(first->second);
+  std::nth_element(fPzvSelected.begin(), fPzvSelected.begin() + ipick, fPzvSelected.end());
+  return fPzvSelected[ipick];
 }
 
 
@@ -655,7 +716,18 @@ Bool_t GenieGenerator::ReadEvent(FairPrimaryGenerator* cpg)
     Double_t y;
     Double_t z;
     Int_t count=0;
-    while (prob2int<gRandom->Uniform(0.,1.)) {
+    //density weighted pick from the profile of the MeanMaterialBudget walk,
+    //the rejection sampling below is only used if that walk failed
+    Bool_t fromProfile = SampleInteractionZ(start, end, z);
+    if (fromProfile){
+      x=txnu*(z-ztarget);
+      y=tynu*(z-ztarget);
+      if (fGenOption == 1){
+        x += FLUKA_x;
+        y += FLUKA_y;
+      }
+    }
+    while (!fromProfile && prob2int<gRandom->Uniform(0.,1.)) {
       //place x,y,z uniform along path
       z=gRandom->Uniform(start[2],end[2]);
       x=txnu*(z-ztarget);
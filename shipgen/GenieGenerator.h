@@ -10,6 +10,7 @@
 #include "TVector3.h"                        
 #include "FairLogger.h"                 // for FairLogger, MESSAGE_ORIGIN
 #include "vector"
+#include <utility>
 
 class FairPrimaryGenerator;
 
@@ -37,6 +38,8 @@ class GenieGenerator : public FairGenerator
   }
   void AddBox(TVector3 dVec, TVector3 box);
   Double_t MeanMaterialBudget(const Double_t *start, const Double_t *end, Double_t *mparam);
+  /** z of an interaction point on start-end, sampled from the density profile of the last MeanMaterialBudget walk **/
+  Bool_t SampleInteractionZ(const Double_t *start, const Double_t *end, Double_t &z);
   void SetDeltaE_Matching_FLUKAGenie(Double_t DeltaE){
     fDeltaE_GenieFLUKA_nu = DeltaE;
   }
@@ -49,6 +52,8 @@ class GenieGenerator : public FairGenerator
  private:
   std::vector<double> Rotate(Double_t x, Double_t y, Double_t z, Double_t px, Double_t py, Double_t pz); 
   Int_t ExtractEvent_Ekin(Double_t Ekin, Double_t DeltaE);
+  /** sort the GENIE entries by pzv for ExtractEvent_Ekin **/
+  void BuildEnergyIndex();
  private:
   
  protected:
@@ -77,6 +82,10 @@ class GenieGenerator : public FairGenerator
   TH1D* pxhist[3000];//!
   TH1D* pyslice[3000][500];//!
   TClonesArray *ancstr;//!
+  std::vector<std::pair<Double_t,Int_t>> fPzvIndex;//! (pzv, GENIE entry), sorted
+  std::vector<Int_t> fPzvSelected;//! entries of the current energy window
+  std::vector<Double_t> fProfileLength;//! segment lengths along the last MeanMaterialBudget trajectory
+  std::vector<Double_t> fProfileDensity;//! density of each segment
 
   ClassDef(GenieGenerator,2);
 };
@@ -86,6 +86,9 @@ Double_t MuDISGenerator::MeanMaterialBudget(const Double_t *start, const Double_
 
   for (Int_t i=0;i<6;i++) bparam[i]=0;
 
+  fProfileLength.clear();
+  fProfileDensity.clear();
+
   if (!gGeoManager) {
     //AliFatalClass("No TGeo\n");
     return 0.;
@@ -137,6 +140,8 @@ Double_t MuDISGenerator::MeanMaterialBudget(const Double_t *start, const Double_
   Double_t snext = gGeoManager->GetStep();
   // If no boundary within proposed length, return current density
   if (!gGeoManager->IsOnBoundary()) {
+    fProfileLength.push_back(lparam[4]);
+    fProfileDensity.push_back(lparam[0]);
     mparam[0] = lparam[0];
     mparam[1] = lparam[4]/lparam[1];
     mparam[2] = lparam[2];
@@ -162,6 +167,8 @@ Double_t MuDISGenerator::MeanMaterialBudget(const Double_t *start, const Double_
       mparam[4] = step;
       mparam[0] = 0.;             // if crash of navigation take mean density 0
       mparam[1] = 1000000;        // and infinite rad length
+      fProfileLength.clear();     // and no density profile
+      fProfileDensity.clear();
       return bparam[0]/step;
     }
     mparam[6]+=1.;
@@ -171,6 +178,8 @@ Double_t MuDISGenerator::MeanMaterialBudget(const Double_t *start, const Double_
     bparam[3]    += snext*lparam[3];
     bparam[5]    += snext*lparam[5];
     bparam[0]    += snext*lparam[0];
+    fProfileLength.push_back(snext);
+    fProfileDensity.push_back(lparam[0]);
 
     if (snext>=length) break;
     if (!currentnode) break;
@@ -203,6 +212,36 @@ Double_t MuDISGenerator::MeanMaterialBudget(const Double_t *start, const Double_
   return bparam[0]/step;
 }
 
+Bool_t MuDISGenerator::SampleInteractionZ(const Double_t *start, const Double_t *end, Double_t &z)
+{
+  // Pick the interaction point along the straight line start-end with a
+  // probability proportional to the local density, by inverting the
+  // cumulative density of the segments recorded by the last call to
+  // MeanMaterialBudget(start, end, ...). Returns kFALSE if that walk gave
+  // no usable profile.
+  Double_t total = 0.;
+  for (size_t i=0; i<fProfileLength.size(); i++) total += fProfileLength[i]*fProfileDensity[i];
+  if (!(total > 0.)) return kFALSE;
+
+  Double_t length = TMath::Sqrt((end[0]-start[0])*(end[0]-start[0])+
+                                (end[1]-start[1])*(end[1]-start[1])+
+                                (end[2]-start[2])*(end[2]-start[2]));
+  Double_t u = gRandom->Uniform(0.,total);
+  Double_t path = 0.;
+  for (size_t i=0; i<fProfileLength.size(); i++) {
+    Double_t w = fProfileLength[i]*fProfileDensity[i];
+    if (u < w || i+1 == fProfileLength.size()) {
+      path += fProfileDensity[i] > 0. ? TMath::Min(u/fProfileDensity[i], fProfileLength[i]) : 0.;
+      break;
+    }
+    u -= w;
+    path += fProfileLength[i];
+  }
+  if (path > length) path = length;
+  z = start[2] + (end[2]-start[2])*path/length;
+  return kTRUE;
+}
+
 // -----   Destructor   ----------------------------------------------------
 MuDISGenerator::~MuDISGenerator()
 {
@@ -256,7 +295,14 @@ Bool_t MuDISGenerator::ReadEvent(FairPrimaryGenerator* cpg)
     Int_t count=0;
     LOG(DEBUG)  << " Start prob2int while loop, bparam= "              << bparam << ", " << bparam*1.e8 ;
     LOG(DEBUG)  << " What was maximum density, mparam[7]= " << mparam[7] << ", " << mparam[7]*1.e8 ;
-    while (prob2int<gRandom->Uniform(0.,1.)) {
+    //density weighted pick from the profile of the MeanMaterialBudget walk,
+    //the rejection sampling below is only used if that walk failed
+    Bool_t fromProfile = SampleInteractionZ(start, end, zmu);
+    if (fromProfile) {
+      xmu=x-(z-zmu)*txmu;
+      ymu=y-(z-zmu)*tymu;
+    }
+    while (!fromProfile && prob2int<gRandom->Uniform(0.,1.)) {
       zmu=gRandom->Uniform(start[2],end[2]);
       xmu=x-(z-zmu)*txmu;
       ymu=y-(z-zmu)*tymu;
@@ -35,6 +35,8 @@ class MuDISGenerator : public FairGenerator
 
  private:
   Double_t MeanMaterialBudget(const Double_t *start, const Double_t *end, Double_t *mparam);
+  /** z of an interaction point on start-end, sampled from the density profile of the last MeanMaterialBudget walk **/
+  Bool_t SampleInteractionZ(const Double_t *start, const Double_t *end, Double_t &z);
 
   
  protected:
@@ -47,6 +49,8 @@ class MuDISGenerator : public FairGenerator
   int fNevents;
   int fn;
   bool fFirst;
+  std::vector<Double_t> fProfileLength;//! segment lengths along the last MeanMaterialBudget trajectory
+  std::vector<Double_t> fProfileDensity;//! density of each segment
   ClassDef(MuDISGenerator,1);
 };
 #endif /* !PNDMuGENERATOR_H */
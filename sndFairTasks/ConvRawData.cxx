@@ -9,14 +9,20 @@
 #include <string>
 #include <stdint.h>
 #include <stdlib.h>             // exit
+#include <cstring>              // memcmp
+#include <cstdio>               // rename
 #include <vector>
+#include <array>
 #include <algorithm>            // std::sort
 #include <sys/stat.h>
+#include <thread>               // for RunParallel workers
+#include <memory>
 #include "TKey.h"
 #include "FairEventHeader.h"    // for FairEventHeader
 #include "SNDLHCEventHeader.h"  // for EventHeader
 #include "FairRunAna.h"         // for FairRunAna
 #include "FairRootManager.h"    // for FairRootManager
+#include "FairSink.h"           // for writing the event tags
 #include "FairParamList.h"
 #include "FairLogger.h"
 #include "ConvRawData.h"
@@ -25,6 +31,7 @@
 #include "TROOT.h"
 #include "TList.h"
 #include "TFile.h"
+#include "TFileMerger.h"
 #include "TTree.h"
 #include "TBranch.h"
 #include "TLeaf.h"
@@ -38,21 +45,57 @@
 #include "TString.h"
 #include "nlohmann/json.hpp"     // library to operate with json files
 #include "boardMappingParser.h"  // for board mapping
+#include "RawLeafArray.h"        // for bound input leaves
 #include "XrdCl/XrdClFile.hh"
 
 using namespace std;
 using namespace std::chrono;
 using namespace XrdCl;
 
+// Per-hit diagnostics. They are compiled out unless built with -DCONVRAWDATA_TRACE,
+// and then printed only while the trace flag is set (debug option or SetHitTrace).
+#ifdef CONVRAWDATA_TRACE
+#define TRACE_HIT if (fTraceHits.load(std::memory_order_relaxed)) LOG (info)
+#else
+#define TRACE_HIT if (false) LOG (info)
+#endif
+
+namespace {
+// Binary cache of the calibration tables, see ConvRawData::read_csv.
+// The version must change whenever QdcCalPar, TdcCalPar or the table layout change.
+const char kCalibCacheMagic[8] = {'S','N','D','C','A','L','1','\0'};
+const uint32_t kCalibCacheVersion = 1;
+struct CalibCacheHeader
+{
+  char magic[8];
+  uint32_t version;
+  int32_t nBoards;
+  uint64_t stamp[4];   // size and mtime of qdc_cal.csv and tdc_cal.csv
+  uint64_t nQdc, nTdc;
+  uint64_t checksum;   // of the payload
+};
+// FNV-1a 64 bit hash
+uint64_t fnv1a(const void* data, size_t n, uint64_t h = 14695981039346656037ULL)
+{
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < n; i++) { h ^= p[i]; h *= 1099511628211ULL; }
+  return h;
+}
+// Read-only map lookup returning a default-constructed value for missing keys,
+// the mapping tables are shared by all conversion workers and must not grow
+template <class M>
+const typename M::mapped_type& constAt(const M& m, const typename M::key_type& k)
+{
+  static const typename M::mapped_type empty{};
+  auto it = m.find(k);
+  return (it == m.end()) ? empty : it->second;
+}
+}
+
 
 ConvRawData::ConvRawData()
     : FairTask("ConvRawData")
-    , fEventTree(nullptr)
-    , boards{}
-    , fEventHeader(nullptr)
-    , fSNDLHCEventHeader(nullptr)
-    , fDigiSciFi(nullptr)
-    , fDigiMuFilter(nullptr)
+    , fState{}
 {}
 
 ConvRawData::~ConvRawData() {}
@@ -97,37 +140,26 @@ InitStatus ConvRawData::Init()
     std::istringstream(saturationLimit_obj->GetString().Data()) >> saturationLimit;
     std::istringstream(newFormat_obj->GetString().Data()) >> newFormat;
     std::istringstream(local_obj->GetString().Data()) >> local;
+    SetHitTrace(debug);
     
+    fInputName = f0->GetName();
     if (!newFormat)
-    { 
-       fEventTree = (TTree*)f0->Get("event"); 
-       // Get board_x data
-       TIter next(f0->GetListOfKeys());
-       TKey *b = new TKey();
-       string name;
-       while ((b = (TKey*)next()))
-       {
-          name = b->GetName();
-          // string.find func: If no matches were found, the function returns string::npos.
-          if ( name.find("board") == string::npos ) continue;
-          boards[name] = (TTree*)f0->Get(name.c_str());
-        }
+    {
         // use FairRoot eventHeader class
-        fEventHeader = new FairEventHeader();
-        ioman->Register("EventHeader", "sndEventHeader", fEventHeader, kTRUE);
+        fState.eventHeader = new FairEventHeader();
+        ioman->Register("EventHeader", "sndEventHeader", fState.eventHeader, kTRUE);
     }
     else
     {
-        fEventTree = (TTree*)f0->Get("data");
         // use sndlhc eventHeader class
-        fSNDLHCEventHeader = new SNDLHCEventHeader();
-        ioman->Register("EventHeader", "sndEventHeader", fSNDLHCEventHeader, kTRUE);        
+        fState.sndEventHeader = new SNDLHCEventHeader();
+        ioman->Register("EventHeader", "sndEventHeader", fState.sndEventHeader, kTRUE);        
     }
      
-    fDigiSciFi    = new TClonesArray("sndScifiHit");
-    ioman->Register("Digi_ScifiHits", "DigiScifiHit_det", fDigiSciFi, kTRUE);
-    fDigiMuFilter = new TClonesArray("MuFilterHit");
-    ioman->Register("Digi_MuFilterHits", "DigiMuFilterHit_det", fDigiMuFilter, kTRUE);
+    fState.digiSciFi    = new TClonesArray("sndScifiHit");
+    ioman->Register("Digi_ScifiHits", "DigiScifiHit_det", fState.digiSciFi, kTRUE);
+    fState.digiMuFilter = new TClonesArray("MuFilterHit");
+    ioman->Register("Digi_MuFilterHits", "DigiMuFilterHit_det", fState.digiMuFilter, kTRUE);
     ScifiDet = dynamic_cast<Scifi*> (gROOT->GetListOfGlobals()->FindObject("Scifi") );
     
     TStopwatch timerCSV;
@@ -140,595 +172,643 @@ InitStatus ConvRawData::Init()
     timerBMap.Start();
     DetMapping(fpathJSON);
     if (newFormat) StartTimeofRun(fpathJSON);
+    buildDaqChannels();
     timerBMap.Stop();
     LOG (info) << "Time to set the board mapping " << timerBMap.RealTime();
     
+    // Resolve the input trees and leaves once, the hit loops then read plain arrays
+    if (!OpenInput(fState, f0)) return kFATAL;
+
     // Get the FairLogger
     FairLogger *logger = FairLogger::GetLogger();
     
-    eventNumber = fnStart;
+    fState.eventNumber = fnStart;
     
     return kSUCCESS;
 }
 
 void ConvRawData::Exec(Option_t* /*opt*/)
 {     
-     fDigiSciFi->Delete();
-     fDigiMuFilter->Delete();
-     
-     if (!newFormat) Process0();
-     else Process1();
+     ConvertEvent(fState);
 
      // Manually change event number as input file is not set as source for this task
-     eventNumber++;
+     fState.eventNumber++;
+
+}
 
+void ConvRawData::Finish()
+{
+     LOG (info) << "ConvRawData: timing of " << fState.timing.calls[StageTimer::kEvent] << " events";
+     fState.timing.Print();
+     FairSink* sink = FairRootManager::Instance()->GetSink();
+     if (newFormat && sink && !fState.tags.empty())
+     {
+        unique_ptr<TTree> tagTree(MakeEventTagTree(fState.tags));
+        sink->WriteObject(tagTree.get(), "EventTags", TObject::kOverwrite);
+     }
+}
+
+void ConvRawData::ConvertEvent(ConvState& s)
+{
+     // hits own no heap memory, Clear keeps the slots for in-place construction
+     s.digiSciFi->Clear();
+     s.digiMuFilter->Clear();
+     
+     if (!newFormat) Process0(s);
+     else Process1(s);
 }
 
 void ConvRawData::UpdateInput(int NewStart)
 { 
-   fEventTree->Refresh();
+   fState.eventTree->Refresh();
+   if (!newFormat)
+      for (auto it : fState.boards) fState.boards[it.first]->Refresh();
+   // leaves may be recreated by the refresh, resolve them again
+   BindInput(fState);
+   fState.eventNumber = NewStart; 
+}
+
+bool ConvRawData::RunParallel(int nThreads, string outFile)
+{
+   int nTotal = fnEvents - fnStart;
+   if (nTotal <= 0)
+   {
+      LOG (warning) << "RunParallel: no events to convert";
+      return true;
+   }
+   nThreads = max(1, min(nThreads, nTotal));
+   ROOT::EnableThreadSafety();
+   LOG (info) << "Converting events " << fnStart << " to " << fnEvents
+              << " on " << nThreads << " threads";
+   TStopwatch timer;
+   timer.Start();
+   fParallelTiming = StageTimer{};
+   // Contiguous event ranges, one temporary output file per worker
+   vector<string> partFiles{};
+   vector<int> status(nThreads, 0);
+   vector<vector<EventTag>> workerTags(nThreads);
+   vector<thread> workers{};
+   for (int w = 0; w < nThreads; w++)
+   {
+      int nFirst = fnStart + int(int64_t(nTotal)*w/nThreads);
+      int nLast  = fnStart + int(int64_t(nTotal)*(w+1)/nThreads);
+      partFiles.push_back(outFile + ".part" + to_string(w));
+      workers.emplace_back([this, w, nFirst, nLast, &partFiles, &status, &workerTags]()
+                           { status[w] = ConvertRange(nFirst, nLast, partFiles[w], workerTags[w]); });
+   }
+   for (auto& worker : workers) worker.join();
+   
+   // A missing range would leave a silent gap in rawConv, write nothing then
+   bool ok = true;
+   for (int w = 0; w < nThreads; w++)
+   {
+      if (!status[w])
+      {
+         LOG (error) << "RunParallel: worker " << w << " failed on " << partFiles[w];
+         ok = false;
+      }
+   }
+   if (!ok)
+   {
+      for (auto& part : partFiles) gSystem->Unlink(part.c_str());
+      LOG (error) << "RunParallel: conversion failed, " << outFile << " is not written";
+      return false;
+   }
+   // Merge the parts in event order
+   TFileMerger merger(kFALSE);
+   merger.OutputFile(outFile.c_str(), "RECREATE");
+   for (auto& part : partFiles) merger.AddFile(part.c_str(), kFALSE);
+   ok = merger.Merge();
+   for (auto& part : partFiles) gSystem->Unlink(part.c_str());
+   if (!ok)
+   {
+      LOG (error) << "RunParallel: merging into " << outFile << " failed";
+      gSystem->Unlink(outFile.c_str());
+      return false;
+   }
+   // Same list of branch classes as written by the python converter
+   TFile fOutput(outFile.c_str(), "UPDATE");
+   TList branchList;
+   branchList.SetName("BranchList");
+   branchList.Add(new TObjString("sndScifiHit"));
+   branchList.Add(new TObjString("MuFilterHit"));
+   branchList.Add(new TObjString(newFormat ? "SNDLHCEventHeader" : "FairEventHeader"));
+   branchList.Write("BranchList", TObject::kSingleKey);
+   branchList.Delete();
+   // Tags of the workers, in the same order as the merged entries
+   vector<EventTag> tags{};
+   for (int w = 0; w < nThreads; w++)
+      tags.insert(tags.end(), workerTags[w].begin(), workerTags[w].end());
+   if (newFormat && !tags.empty())
+   {
+      unique_ptr<TTree> tagTree(MakeEventTagTree(tags));
+      fOutput.WriteTObject(tagTree.get(), "EventTags", "Overwrite");
+   }
+   fOutput.Close();
+   timer.Stop();
+   LOG (info) << "RunParallel: " << nTotal << " events converted in " << timer.RealTime() << " s";
+   fParallelTiming.Print();
+   return true;
+}
+
+int ConvRawData::ConvertNew(int maxEvents)
+{
+   // Same as UpdateInput: re-read the trees as written so far, rebind the leaves
+   fState.eventTree->Refresh();
+   if (!newFormat)
+      for (auto it : fState.boards) it.second->Refresh();
+   BindInput(fState);
+   // Only entries present in all trees are complete
+   Long64_t nAvailable = fState.eventTree->GetEntries();
+   if (!newFormat)
+      for (auto it : fState.boards) nAvailable = min(nAvailable, it.second->GetEntries());
+   
+   // Followed events are never filled into the output, so they get no tag either
+   fState.recordTags = false;
+   int n = 0;
+   while (fState.eventNumber < nAvailable && (maxEvents <= 0 || n < maxEvents)
+          && !fStopFollow.load())
+   {
+      ConvertEvent(fState);
+      if (fEventCallback) fEventCallback(fState.eventNumber);
+      fState.eventNumber++;
+      n++;
+   }
+   fState.recordTags = true;
+   return n;
+}
+
+string ConvRawData::nextPartition(const string& name)
+{
+   size_t pos = name.rfind("data_");
+   size_t end = name.rfind(".root");
+   if (pos == string::npos || end == string::npos || end <= pos+5) return "";
+   string digits = name.substr(pos+5, end-pos-5);
+   if (digits.find_first_not_of("0123456789") != string::npos) return "";
+   string next = to_string(stoi(digits)+1);
+   if (next.size() < digits.size()) next = string(digits.size()-next.size(), '0') + next;
+   return name.substr(0, pos+5) + next + name.substr(end);
+}
+
+void ConvRawData::Follow(int pollMs, double idleTimeout)
+{
+   fStopFollow.store(false);
+   LOG (info) << "Follow: converting " << fInputName << " from event " << fState.eventNumber;
+   steady_clock::time_point lastEvent = steady_clock::now();
+   while (!fStopFollow.load())
+   {
+      // Convert in chunks, so a backlog does not delay the checks below
+      if (ConvertNew(fheartBeat) > 0)
+      {
+         lastEvent = steady_clock::now();
+         continue;
+      }
+      string next = nextPartition(fInputName);
+      if (!next.empty() && !gSystem->AccessPathName(next.c_str()))
+      {
+         // The DAQ may have created the file but not yet written the trees
+         unique_ptr<TFile> fNext(TFile::Open(next.c_str()));
+         if (fNext && !fNext->IsZombie() && fNext->Get(newFormat ? "data" : "event"))
+         {
+            if (!OpenInput(fState, fNext.get()))
+            {
+               LOG (error) << "Follow: cannot read " << next << ", stopping";
+               break;
+            }
+            LOG (info) << "Follow: continuing with " << next;
+            fInputName = next;
+            fFollowFile = move(fNext);
+            fState.eventNumber = 0;
+            continue;
+         }
+      }
+      if (idleTimeout > 0 && duration<double>(steady_clock::now() - lastEvent).count() > idleTimeout)
+      {
+         LOG (info) << "Follow: no new events for " << idleTimeout << " s, stopping";
+         break;
+      }
+      this_thread::sleep_for(milliseconds(pollMs));
+   }
+   LOG (info) << "Follow: stopped at event " << fState.eventNumber << " of " << fInputName;
+}
+
+bool ConvRawData::ConvertRange(int nFirst, int nLast, string partFile, vector<EventTag>& tags)
+{
+   // Own input file, trees and leaves for this worker
+   unique_ptr<TFile> fIn(TFile::Open(fInputName.c_str()));
+   if (!fIn || fIn->IsZombie())
+   {
+      LOG (error) << "ConvertRange: cannot open " << fInputName;
+      return false;
+   }
+   ConvState s{};
+   if (!OpenInput(s, fIn.get())) return false;
+   
+   TFile fPart(partFile.c_str(), "RECREATE");
+   if (fPart.IsZombie())
+   {
+      LOG (error) << "ConvertRange: cannot create " << partFile;
+      return false;
+   }
+   TTree tree("rawConv", "raw data converted");
+   unique_ptr<TClonesArray> digiSciFi(new TClonesArray("sndScifiHit"));
+   unique_ptr<TClonesArray> digiMuFilter(new TClonesArray("MuFilterHit"));
+   s.digiSciFi = digiSciFi.get();
+   s.digiMuFilter = digiMuFilter.get();
+   unique_ptr<FairEventHeader> eventHeader{};
+   unique_ptr<SNDLHCEventHeader> sndEventHeader{};
+   if (!newFormat)
+   {
+      eventHeader.reset(new FairEventHeader());
+      s.eventHeader = eventHeader.get();
+      tree.Branch("EventHeader", &s.eventHeader, 32000, -1);
+   }
+   else
+   {
+      sndEventHeader.reset(new SNDLHCEventHeader());
+      s.sndEventHeader = sndEventHeader.get();
+      tree.Branch("EventHeader", &s.sndEventHeader, 32000, -1);
+   }
+   tree.Branch("Digi_ScifiHits", &s.digiSciFi, 32000, 1);
+   tree.Branch("Digi_MuFilterHits", &s.digiMuFilter, 32000, 1);
+   
+   for (s.eventNumber = nFirst; s.eventNumber < nLast; s.eventNumber++)
+   {
+      ConvertEvent(s);
+      tree.Fill();
+   }
+   bool written = tree.Write() > 0;
+   fPart.Close();
+   if (!written || fPart.TestBit(TFile::kWriteError))
+   {
+      LOG (error) << "ConvertRange: writing " << partFile << " failed";
+      return false;
+   }
+   tags = move(s.tags);
+   LOG (info) << "ConvertRange: events " << nFirst << " to " << nLast << " done";
+   lock_guard<mutex> lock(fTimingMutex);
+   fParallelTiming.Merge(s.timing);
+   return true;
+}
+
+TTree* ConvRawData::MakeEventTagTree(const vector<EventTag>& tags)
+{
+   // Plain leaves only, each column is read on its own without the event classes
+   TTree* tree = new TTree("EventTags", "event tags of converted events");
+   tree->SetDirectory(nullptr);
+   EventTag tag{};
+   Int_t entry{};
+   tree->Branch("entry", &entry, "entry/I");
+   tree->Branch("eventNumber", &tag.eventNumber, "eventNumber/I");
+   tree->Branch("UTCtimestamp", &tag.UTCtimestamp, "UTCtimestamp/L");
+   tree->Branch("fillNumber", &tag.fillNumber, "fillNumber/s");
+   tree->Branch("accMode", &tag.accMode, "accMode/b");
+   tree->Branch("beamMode", &tag.beamMode, "beamMode/b");
+   tree->Branch("fastFilters", &tag.fastFilters, "fastFilters/b");
+   tree->Branch("advFilters", &tag.advFilters, "advFilters/s");
+   for (entry = 0; entry < int(tags.size()); entry++)
+   {
+      tag = tags[entry];
+      tree->Fill();
+   }
+   return tree;
+}
+
+bool ConvRawData::OpenInput(ConvState& s, TFile* f0)
+{
+   s.sciFiIndex.assign(nSciFiSlots, -1);
+   s.muFilterIndex.assign(nMuFilterSlots, -1);
+   s.boards.clear();
    if (!newFormat)
-      for (auto it : boards) boards[it.first]->Refresh();
-   eventNumber = NewStart; 
+   { 
+      s.eventTree = (TTree*)f0->Get("event"); 
+      // Get board_x data
+      TIter next(f0->GetListOfKeys());
+      TKey *b;
+      string name;
+      while ((b = (TKey*)next()))
+      {
+         name = b->GetName();
+         // string.find func: If no matches were found, the function returns string::npos.
+         if ( name.find("board") == string::npos ) continue;
+         s.boards[name] = (TTree*)f0->Get(name.c_str());
+      }
+   }
+   else s.eventTree = (TTree*)f0->Get("data");
+   if (!s.eventTree)
+   {
+      LOG (error) << "No raw-data tree found in " << f0->GetName();
+      return false;
+   }
+   return BindInput(s);
 }
 
-void ConvRawData::Process0()
+bool ConvRawData::BindInput(ConvState& s)
+{
+   bool ok = s.evtTimestamp.Bind(s.eventTree, "evtTimestamp");
+   if (!newFormat)
+   {
+      for (auto it : s.boards)
+         ok = s.boardHits[it.first].Bind(it.second, false, !makeCalibration) && ok;
+   }
+   else
+   {
+      ok = s.evtFlags.Bind(s.eventTree, "evtFlags") && ok;
+      ok = s.evtNumber.Bind(s.eventTree, "evtNumber") && ok;
+      ok = s.hits.Bind(s.eventTree, true, !makeCalibration) && ok;
+   }
+   return ok;
+}
+
+void ConvRawData::Process0(ConvState& s)
 {   
-  int indexSciFi{}, indexMuFilter{};
-  bool scifi = false, mask = false;
   int board_id{};
   TTree* bt;
-  int tofpet_id{}, tofpet_channel{}, tac{}, mat{};
-  string station;
-  double TDC{}, QDC{}, Chi2ndof{}, satur{};
-  int A{};
-  double B{};
-  high_resolution_clock::time_point tE{}, t0{}, t1{}, t4{}, t5{}, t6{}, tt{};
-  int system{}, key{}, sipmChannel{};
-  string tmp;
-  int nSiPMs{}, nSides{}, direction{}, detID{}, sipm_number{}, chan{}, orientation{}, sipmLocal{};
-  int sipmID{};
-  double test{};
+  high_resolution_clock::time_point tE{}, t6{}, tt{};
+  int nHits{};
   //TStopwatch timer;     
   
   tE = high_resolution_clock::now();
   //timer.Start();
-  fEventTree->GetEvent(eventNumber);
-  if ( eventNumber%fheartBeat == 0 )
+  s.eventTree->GetEvent(s.eventNumber);
+  if ( s.eventNumber%fheartBeat == 0 )
   {
      tt = high_resolution_clock::now();
      time_t ttp = high_resolution_clock::to_time_t(tt);
-     LOG (info) << "run " << frunNumber << " event " << eventNumber
+     LOG (info) << "run " << frunNumber << " event " << s.eventNumber
                 << " local time " << ctime(&ttp);
   }
      
-  fEventHeader->SetRunId(frunNumber);
-  fEventHeader->SetEventTime(fEventTree->GetLeaf("evtTimestamp")->GetValue());
-  LOG (info) << "event: " << eventNumber << " timestamp: "
-              << fEventTree->GetLeaf("evtTimestamp")->GetValue();
-  // Delete pointer map elements
-  for (auto it : digiSciFiStore)
-  {
-      delete it.second;
-  }
-  digiSciFiStore.clear();
-  for (auto it : digiMuFilterStore)
-  {
-      delete it.second;
-  }
-  digiMuFilterStore.clear();
+  s.eventHeader->SetRunId(frunNumber);
+  s.evtTimestamp.Read(1);
+  s.eventHeader->SetEventTime(s.evtTimestamp[0]);
+  LOG (info) << "event: " << s.eventNumber << " timestamp: "
+              << s.evtTimestamp[0];
      
   // Loop over boards
-  for ( auto board : boards )// loop over TTrees
+  for ( auto board : s.boards )// loop over TTrees
   { 
        board_id = stoi(board.first.substr(board.first.find("_")+1));
-       scifi = true;
-       if (boardMaps["Scifi"].count(board.first)!=0) 
-       {
-         for (auto it : boardMaps["Scifi"][board.first])
-         {
-           station = it.first;
-           mat = it.second;
-         }         
-       }
-       else if (boardMaps["MuFilter"].count(board.first)!=0) scifi = false;
-       else
+       if (!boardKnown(board_id))
        {
          LOG (error) << board.first << " not known. Serious error, stop!";
          break;
        }
-       bt = boards[board.first];
-       bt->GetEvent(eventNumber);
+       bt = board.second;
+       bt->GetEvent(s.eventNumber);
+       RawHitArrays& hits = s.boardHits[board.first];
+       nHits = hits.Read();
        // Loop over hits in event
-       for ( int n = 0; n <  bt->GetLeaf("nHits")->GetValue(); n++ )
+       for ( int n = 0; n < nHits; n++ )
        {
-         mask = false;
-         LOG (info) << "In scifi? " << scifi 
-                    << " " << board_id << " " << bt->GetLeaf("tofpetId")->GetValue(n)
-                    << " " << bt->GetLeaf("tofpetChannel")->GetValue(n)
-                    << " " << bt->GetLeaf("tac")->GetValue(n)
-                    << " " << bt->GetLeaf("tCoarse")->GetValue(n)
-                    << " " << bt->GetLeaf("tFine")->GetValue(n)
-                    << " " << bt->GetLeaf("vCoarse")->GetValue(n)
-                    << " " << bt->GetLeaf("vFine")->GetValue(n);
-         t0 = high_resolution_clock::now();
-         tofpet_id = bt->GetLeaf("tofpetId")->GetValue(n);
-         tofpet_channel = bt->GetLeaf("tofpetChannel")->GetValue(n);
-         tac = bt->GetLeaf("tac")->GetValue(n);
-         /* Since run 39 calibration is done online and 
-         calib data stored in root raw data file */
-         if (makeCalibration)
-           tie(TDC,QDC,Chi2ndof,satur) = comb_calibration(board_id, tofpet_id, tofpet_channel, tac,
-                                                     bt->GetLeaf("vCoarse")->GetValue(n),
-                                                     bt->GetLeaf("vFine")->GetValue(n),
-                                                     bt->GetLeaf("tCoarse")->GetValue(n),
-                                                     bt->GetLeaf("tFine")->GetValue(n),
-                                                     1.0, 0);
-         else
-         {
-           TDC = bt->GetLeaf("timestamp")->GetValue(n);
-           QDC = bt->GetLeaf("value")->GetValue(n);
-           Chi2ndof = 1;
-           satur = 0.;
-           //Chi2ndof = max(bt->GetLeaf("timestampCalChi2")->GetValue(n)/bt->GetLeaf("timestampCalDof")->GetValue(n),
-           //               bt->GetLeaf("valueCalChi2")->GetValue(n)/bt->GetLeaf("valueCalDof")->GetValue(n));
-           // FIXME, valueCalDof is a boolean that is true if v_fine/par[d] is above saturationLimit              
-           //satur = (bt->GetLeaf("valueCalDof")->GetValue(n) == 1) ? 1.1*saturationLimit : 0.9*saturationLimit;    
-         }
-         
-         // Print a warning if TDC or QDC is nan.        
-         if ( TDC != TDC || QDC!=QDC) {
-         LOG (warning) << "NAN tdc/qdc detected! Check maps!"
-                       << " " << board_id << " " << bt->GetLeaf("tofpetId")->GetValue(n)
-                       << " " << bt->GetLeaf("tofpetChannel")->GetValue(n)
-                       << " " << bt->GetLeaf("tac")->GetValue(n)
-                       << " " << bt->GetLeaf("tCoarse")->GetValue(n)
-                       << " " << bt->GetLeaf("tFine")->GetValue(n)
-                       << " " << bt->GetLeaf("vCoarse")->GetValue(n)
-                       << " " << bt->GetLeaf("vFine")->GetValue(n);
-         }
-         
-         t1 = high_resolution_clock::now();
-         if ( Chi2ndof > chi2Max )
-         {
-           if (QDC>1E20) QDC = 997.; // checking for inf
-           if (QDC != QDC) QDC = 998.; // checking for nan
-           if (QDC>0) QDC = -QDC;
-           mask = true;
-         }
-         else if (satur > saturationLimit || QDC>1E20 || QDC != QDC)
-         {
-           if (QDC>1E20) QDC = 987.; // checking for inf
-           LOG (info) << "inf " << board_id << " " << bt->GetLeaf("tofpetId")->GetValue(n)    
-                      << " " << bt->GetLeaf("tofpetChannel")->GetValue(n)
-                      << " " << bt->GetLeaf("tac")->GetValue(n) 
-                      << " " << bt->GetLeaf("vCoarse")->GetValue(n)
-                      << " " << bt->GetLeaf("vFine")->GetValue(n)
-                      << " " << TDC-bt->GetLeaf("tCoarse")->GetValue(n) 
-                      << " " << eventNumber << " " << Chi2ndof;
-           if (QDC != QDC) QDC = 988.; // checking for nan
-           LOG (info) << "nan " << board_id << " " << bt->GetLeaf("tofpetId")->GetValue(n)
-                       << " " << bt->GetLeaf("tofpetChannel")->GetValue(n)
-                       << " " << bt->GetLeaf("tac")->GetValue(n)
-                       << " " << bt->GetLeaf("vCoarse")->GetValue(n)
-                       << " " << bt->GetLeaf("vFine")->GetValue(n)
-                       << " " << TDC-bt->GetLeaf("tCoarse")->GetValue(n)
-                       << " " << TDC << " " << bt->GetLeaf("tCoarse")->GetValue(n)
-                       << " " << eventNumber << " " << Chi2ndof;
-           A = int(min(QDC,double(1000.)));
-           B = min(satur,double(999.))/1000.;
-           QDC = A+B;
-           mask = true;
-         }
-         else if ( Chi2ndof > chi2Max )
-         {
-            if (QDC>0) QDC = -QDC;
-            mask = true;
-         }         
-         LOG (info) << "calibrated: tdc = " << TDC << ", qdc = " << QDC;//TDC clock cycle = 160 MHz or 6.25ns
-         t4 = high_resolution_clock::now();
-         // Set the unit of the execution time measurement to ns
-         counters["qdc"]+= duration_cast<nanoseconds>(t1 - t0).count();
-         counters["make"]+= duration_cast<nanoseconds>(t4-t0).count();
-         
-         // MuFilter encoding
-         if (!scifi)
-         {
-           system = MufiSystem[board_id][tofpet_id];
-           key = (tofpet_id%2)*1000 + tofpet_channel;
-           tmp = boardMapsMu["MuFilter"][board.first][slots[tofpet_id]];
-           if (debug || !tmp.find("not") == string::npos )
-           {
-             LOG (info) << system << " " << key << " " << board.first << " " << tofpet_id
-                         << " " << tofpet_id%2 << " " << tofpet_channel;
-           }
-           sipmChannel = 99;
-           if ( TofpetMap[system].count(key) == 0)
-           {
-                        cout << "key " << key << " does not exist. " << endl
-                             << board.first << " Tofpet id " << tofpet_id
-                             << " System " << system << " has Tofpet map elements: {";
-                        for ( auto it : TofpetMap[system])
-                        {
-                          cout << it.first << " : " << it.second << ", ";
-                        }
-                        cout << "}\n";
-           }
-           else sipmChannel = TofpetMap[system][key]-1;
-           
-           nSiPMs = abs(offMap[tmp][1]);
-           nSides = abs(offMap[tmp][2]);
-           direction = int(offMap[tmp][1]/nSiPMs);
-           detID = offMap[tmp][0] + direction*int(sipmChannel/nSiPMs);
-           sipm_number = sipmChannel%(nSiPMs);
-           if ( tmp.find("Right") != string::npos ) sipm_number+= nSiPMs;
-           if (digiMuFilterStore.count(detID)==0) 
-           {
- 	     digiMuFilterStore[detID] = new MuFilterHit(detID,nSiPMs,nSides);
-           }
-           test = digiMuFilterStore[detID]->GetSignal(sipm_number);
-           digiMuFilterStore[detID]->SetDigi(QDC,TDC,sipm_number);
-           digiMuFilterStore[detID]->SetDaqID(sipm_number, board_id, tofpet_id, tofpet_channel);
-           if (mask) digiMuFilterStore[detID]->SetMasked(sipm_number);
-           
-           LOG (info) << "create mu hit: " << detID << " " << tmp << " " << system
-                       << " " << tofpet_id << " " << offMap[tmp][0] << " " << offMap[tmp][1]
-                       << " " << offMap[tmp][2] << " " << sipmChannel << " " << nSiPMs
-                       << " " << nSides << " " << test << endl
-                       << detID << " " << sipm_number << " " << QDC << " " << TDC;
-                       
-           if (test>0 || detID%1000>200 || sipm_number>15)
-           {
-             cout << "what goes wrong? " << detID << " SiPM " << sipm_number << " system " << system
-                  << " key " << key << " board " << board.first << " tofperID " << tofpet_id
-                  << " tofperChannel " << tofpet_channel << " test " << test << endl;
-           }
-           t5 = high_resolution_clock::now();
-           counters["createMufi"]+= duration_cast<nanoseconds>(t5 - t4).count();
-         } // end MuFilter encoding
-         
-         else // now Scifi encoding
-         {
-           chan = channel_func(tofpet_id, tofpet_channel, mat);
-           orientation = 1;
-           if (station[2]=='Y') orientation = 0;
-           sipmLocal = (chan - mat*512);
-           sipmID = 1000000*int(station[1]-'0') + 100000*orientation + 10000*mat
-                                            + 1000*(int(sipmLocal/128)) + chan%128;
-           if (digiSciFiStore.count(sipmID)==0)
-           {
-             digiSciFiStore[sipmID] =  new sndScifiHit(sipmID);             
-           }
-           digiSciFiStore[sipmID]->SetDigi(QDC,TDC);
-           digiSciFiStore[sipmID]->SetDaqID(0, board_id, tofpet_id, tofpet_channel);
-           if (mask) digiSciFiStore[sipmID]->setInvalid();
-           LOG (info) << "create scifi hit: tdc = " << board.first << " " << sipmID
-                       << " " << QDC << " " << TDC <<endl
-                       << "tofpet:" << " " << tofpet_id << " " << tofpet_channel << " " << mat
-                       << " " << chan << endl
-                       << station[1] << " " << station[2] << " " << mat << " " << chan
-                       << " " << int(chan/128)%4 << " " << chan%128;
-           t5 = high_resolution_clock::now();
-           counters["createScifi"]+= duration_cast<nanoseconds>(t5 - t4).count();
-         } // end Scifi encoding
+         if (!ConvertHit(s, board_id, hits, n)) break;
        } // end loop over hits in event
   } // end loop over boards (TTrees in data file)
 
-  counters["N"]+= 1;
   t6 = high_resolution_clock::now();
-  for (auto it_sipmID : digiSciFiStore)
-  {
-    (*fDigiSciFi)[indexSciFi]=digiSciFiStore[it_sipmID.first];
-    indexSciFi+= 1;
-  }
-  for (auto it_detID : digiMuFilterStore)
-  {
-    (*fDigiMuFilter)[indexMuFilter]=digiMuFilterStore[it_detID.first];
-    indexMuFilter+= 1;
-  }
-  counters["storage"]+= duration_cast<nanoseconds>(high_resolution_clock::now() - t6).count();
-  counters["event"]+= duration_cast<nanoseconds>(high_resolution_clock::now() - tE).count();
+  StoreHits(s);
+  s.timing.Add(StageTimer::kStorage, duration_cast<nanoseconds>(high_resolution_clock::now() - t6).count());
+  s.timing.Add(StageTimer::kEvent, duration_cast<nanoseconds>(high_resolution_clock::now() - tE).count());
   //timer.Stop();
   //cout<<timer.RealTime()<<endl;
     
   LOG (info) << fnStart+1 << " events processed out of "
-             << fEventTree->GetEntries() << " number of events in file.";
-  /*
-  cout << "Monitor computing time:" << endl;
-  for (auto it: counters)
-  {
-     if( it.first=="N" )
-     {
-       cout << "Processed " << it.first<< " = " << it.second << " events." << endl;
-     }
-     else
-     {
-       // Print execution time in seconds
-       cout << "stage " << it.first<< " took " << it.second*1e-9 << " [s]" << endl;
-     }
-  }
-  */ 
+             << s.eventTree->GetEntries() << " number of events in file.";
 }
 
-void ConvRawData::Process1()
+void ConvRawData::Process1(ConvState& s)
 {    
-  int indexSciFi{}, indexMuFilter{};
-  bool scifi = false, mask = false;
   int board_id{};
-  string board_name;
-  int tofpet_id{}, tofpet_channel{}, tac{}, mat{};
-  string station;
-  double TDC{}, QDC{}, Chi2ndof{}, satur{};
-  int A{};
-  double B{};
-  high_resolution_clock::time_point tE{}, t0{}, t1{}, t4{}, t5{}, t6{}, tt{};
-  int system{}, key{}, sipmChannel{};
-  string tmp;
-  int nSiPMs{}, nSides{}, direction{}, detID{}, sipm_number{}, chan{}, orientation{}, sipmLocal{};
-  int sipmID{};
-  double test{};
+  high_resolution_clock::time_point tE{}, t6{}, tt{};
+  int nHits{};
   //TStopwatch timer;     
   
   tE = high_resolution_clock::now();
   //timer.Start();
-  fEventTree->GetEvent(eventNumber);
-  if ( eventNumber%fheartBeat == 0 )
+  s.eventTree->GetEvent(s.eventNumber);
+  if ( s.eventNumber%fheartBeat == 0 )
   {
      tt = high_resolution_clock::now();
      time_t ttp = high_resolution_clock::to_time_t(tt);
-     LOG (info) << "run " << frunNumber << " event " << eventNumber
+     LOG (info) << "run " << frunNumber << " event " << s.eventNumber
                 << " local time " << ctime(&ttp);
   }
   
-  fSNDLHCEventHeader->SetFlags(fEventTree->GetLeaf("evtFlags")->GetValue());
-  fSNDLHCEventHeader->SetRunId(frunNumber);
-  fSNDLHCEventHeader->SetEventTime(fEventTree->GetLeaf("evtTimestamp")->GetValue());
-  fSNDLHCEventHeader->SetUTCtimestamp(fEventTree->GetLeaf("evtTimestamp")->GetValue()*6.23768*1e-9 + runStartUTC);
-  fSNDLHCEventHeader->SetEventNumber(fEventTree->GetLeaf("evtNumber")->GetValue());
+  s.evtFlags.Read(1);
+  s.evtTimestamp.Read(1);
+  s.evtNumber.Read(1);
+  s.sndEventHeader->SetFlags(s.evtFlags[0]);
+  s.sndEventHeader->SetRunId(frunNumber);
+  s.sndEventHeader->SetEventTime(s.evtTimestamp[0]);
+  s.sndEventHeader->SetUTCtimestamp(s.evtTimestamp[0]*6.23768*1e-9 + runStartUTC);
+  s.sndEventHeader->SetEventNumber(s.evtNumber[0]);
+  if (s.recordTags)
+     s.tags.push_back({s.sndEventHeader->GetEventNumber(), s.sndEventHeader->GetUTCtimestamp(),
+                       s.sndEventHeader->GetFillNumber(),
+                       uint8_t(s.sndEventHeader->GetAccMode()), uint8_t(s.sndEventHeader->GetBeamMode()),
+                       s.sndEventHeader->GetFastNoiseFilterBits(), s.sndEventHeader->GetAdvNoiseFilterBits()});
 
   LOG (info) << "evtNumber per run "
-             << fEventTree->GetLeaf("evtNumber")->GetValue()
-             << " evtNumber per partition: " << eventNumber
-             << " timestamp: " << fEventTree->GetLeaf("evtTimestamp")->GetValue();
-  // Delete pointer map elements
-  for (auto it : digiSciFiStore)
-  {
-      delete it.second;
-  }
-  digiSciFiStore.clear();
-  for (auto it : digiMuFilterStore)
-  {
-      delete it.second;
-  }
-  digiMuFilterStore.clear();
+             << s.evtNumber[0]
+             << " evtNumber per partition: " << s.eventNumber
+             << " timestamp: " << s.evtTimestamp[0];
      
+  nHits = s.hits.Read();
   // Loop over hits per event!
-  for ( int n =0; n < fEventTree->GetLeaf("nHits")->GetValue(); n++ )
+  for ( int n =0; n < nHits; n++ )
   { 
-       board_id = fEventTree->GetLeaf("boardId")->GetValue(n);
-       board_name = "board_"+to_string(board_id);
-       scifi = true;
-       if (boardMaps["Scifi"].count(board_name)!=0) 
-       {
-         for (auto it : boardMaps["Scifi"][board_name])
-         {
-           station = it.first;
-           mat = it.second;
-         }         
-       }
-       else if (boardMaps["MuFilter"].count(board_name)!=0) scifi = false;
-       else
-       {
-         LOG (error) << board_name << " not known. Serious error, stop!";
-         break;
-       }
-       mask = false;
-       LOG (info) << "In scifi? " << scifi 
-                  << " " << board_id << " " << fEventTree->GetLeaf("tofpetId")->GetValue(n)
-                  << " " << fEventTree->GetLeaf("tofpetChannel")->GetValue(n)
-                  << " " << fEventTree->GetLeaf("tac")->GetValue(n)
-                  << " " << fEventTree->GetLeaf("tCoarse")->GetValue(n)
-                  << " " << fEventTree->GetLeaf("tFine")->GetValue(n)
-                  << " " << fEventTree->GetLeaf("vCoarse")->GetValue(n)
-                  << " " << fEventTree->GetLeaf("vFine")->GetValue(n);
-       t0 = high_resolution_clock::now();
-       tofpet_id = fEventTree->GetLeaf("tofpetId")->GetValue(n);
-       tofpet_channel = fEventTree->GetLeaf("tofpetChannel")->GetValue(n);
-       tac = fEventTree->GetLeaf("tac")->GetValue(n);
-       /* Since run 39 calibration is done online and 
-       calib data stored in root raw data file */
-       if (makeCalibration)
-         tie(TDC,QDC,Chi2ndof,satur) = comb_calibration(board_id, tofpet_id, tofpet_channel, tac,
-                                                   fEventTree->GetLeaf("vCoarse")->GetValue(n),
-                                                   fEventTree->GetLeaf("vFine")->GetValue(n),
-                                                   fEventTree->GetLeaf("tCoarse")->GetValue(n),
-                                                   fEventTree->GetLeaf("tFine")->GetValue(n),
-                                                   1.0, 0);
-       else
-       {
-         TDC = fEventTree->GetLeaf("timestamp")->GetValue(n);
-         QDC = fEventTree->GetLeaf("value")->GetValue(n);
-         Chi2ndof = 1;
-         satur = 0.;
-         //Chi2ndof = max(fEventTree->GetLeaf("timestampCalChi2")->GetValue(n)/fEventTree->GetLeaf("timestampCalDof")->GetValue(n),
-         //               fEventTree->GetLeaf("valueCalChi2")->GetValue(n)/fEventTree->GetLeaf("valueCalDof")->GetValue(n));
-         // FIXME, valueCalDof is a boolean that is true if v_fine/par[d] is above saturationLimit              
-         //satur = (fEventTree->GetLeaf("valueCalDof")->GetValue(n) == 1) ? 1.1*saturationLimit : 0.9*saturationLimit;    
-       }
-  
-       // Print a warning if TDC or QDC is nan.        
-       if ( TDC != TDC || QDC!=QDC) {
-       LOG (warning) << "NAN tdc/qdc detected! Check maps!"
-                      << " " << board_id << " " << fEventTree->GetLeaf("tofpetId")->GetValue(n)
-                     << " " << fEventTree->GetLeaf("tofpetChannel")->GetValue(n)
-                     << " " << fEventTree->GetLeaf("tac")->GetValue(n)
-                     << " " << fEventTree->GetLeaf("tCoarse")->GetValue(n)
-                     << " " << fEventTree->GetLeaf("tFine")->GetValue(n)
-                     << " " << fEventTree->GetLeaf("vCoarse")->GetValue(n)
-                     << " " << fEventTree->GetLeaf("vFine")->GetValue(n);
-       }
-         
-       t1 = high_resolution_clock::now();
-       if ( Chi2ndof > chi2Max )
-       {
-         if (QDC>1E20) QDC = 997.; // checking for inf
-         if (QDC != QDC) QDC = 998.; // checking for nan
-         if (QDC>0) QDC = -QDC;
-         mask = true;
-       }
-       else if (satur > saturationLimit || QDC>1E20 || QDC != QDC)
-       {
-         if (QDC>1E20) QDC = 987.; // checking for inf
-         LOG (info) << "inf " << board_id << " " << fEventTree->GetLeaf("tofpetId")->GetValue(n)    
-                    << " " << fEventTree->GetLeaf("tofpetChannel")->GetValue(n)
-                    << " " << fEventTree->GetLeaf("tac")->GetValue(n) 
-                    << " " << fEventTree->GetLeaf("vCoarse")->GetValue(n)
-                    << " " << fEventTree->GetLeaf("vFine")->GetValue(n)
-                    << " " << TDC-fEventTree->GetLeaf("tCoarse")->GetValue(n) 
-                    << " " << eventNumber << " " << Chi2ndof;
-         if (QDC != QDC) QDC = 988.; // checking for nan
-         LOG (info) << "nan " << board_id << " " << fEventTree->GetLeaf("tofpetId")->GetValue(n)
-                     << " " << fEventTree->GetLeaf("tofpetChannel")->GetValue(n)
-                     << " " << fEventTree->GetLeaf("tac")->GetValue(n)
-                     << " " << fEventTree->GetLeaf("vCoarse")->GetValue(n)
-                     << " " << fEventTree->GetLeaf("vFine")->GetValue(n)
-                     << " " << TDC-fEventTree->GetLeaf("tCoarse")->GetValue(n)
-                     << " " << TDC << " " << fEventTree->GetLeaf("tCoarse")->GetValue(n)
-                     << " " << eventNumber << " " << Chi2ndof;
-         A = int(min(QDC,double(1000.)));
-         B = min(satur,double(999.))/1000.;
-         QDC = A+B;
-         mask = true;
-       }
-       else if ( Chi2ndof > chi2Max )
-       {
-          if (QDC>0) QDC = -QDC;
-          mask = true;
-       }         
-         LOG (info) << "calibrated: tdc = " << TDC << ", qdc = " << QDC;//TDC clock cycle = 160 MHz or 6.25ns
-       t4 = high_resolution_clock::now();
-       // Set the unit of the execution time measurement to ns
-       counters["qdc"]+= duration_cast<nanoseconds>(t1 - t0).count();
-       counters["make"]+= duration_cast<nanoseconds>(t4-t0).count();
-       
-       // MuFilter encoding
-       if (!scifi)
-       {
-           system = MufiSystem[board_id][tofpet_id];
-           key = (tofpet_id%2)*1000 + tofpet_channel;
-           tmp = boardMapsMu["MuFilter"][board_name][slots[tofpet_id]];
-           if (debug || !tmp.find("not") == string::npos )
-           {
-             LOG (info) << system << " " << key << " " << board_name << " " << tofpet_id
-                         << " " << tofpet_id%2 << " " << tofpet_channel;
-           }
-           sipmChannel = 99;
-           if ( TofpetMap[system].count(key) == 0)
-           {
-                        cout << "key " << key << " does not exist. " << endl
-                             << board_name << " Tofpet id " << tofpet_id
-                             << " System " << system << " has Tofpet map elements: {";
-                        for ( auto it : TofpetMap[system])
-                        {
-                          cout << it.first << " : " << it.second << ", ";
-                        }
-                        cout << "}\n";
-           }
-           else sipmChannel = TofpetMap[system][key]-1;
-           
-           nSiPMs = abs(offMap[tmp][1]);
-           nSides = abs(offMap[tmp][2]);
-           direction = int(offMap[tmp][1]/nSiPMs);
-           detID = offMap[tmp][0] + direction*int(sipmChannel/nSiPMs);
-           sipm_number = sipmChannel%(nSiPMs);
-           if ( tmp.find("Right") != string::npos ) sipm_number+= nSiPMs;
-           if (digiMuFilterStore.count(detID)==0) 
-           {
- 	     digiMuFilterStore[detID] = new MuFilterHit(detID,nSiPMs,nSides);
-           }
-           test = digiMuFilterStore[detID]->GetSignal(sipm_number);
-           digiMuFilterStore[detID]->SetDigi(QDC,TDC,sipm_number);
-           digiMuFilterStore[detID]->SetDaqID(sipm_number, board_id, tofpet_id, tofpet_channel);
-           if (mask) digiMuFilterStore[detID]->SetMasked(sipm_number);
-           
-           LOG (info) << "create mu hit: " << detID << " " << tmp << " " << system
-                       << " " << tofpet_id << " " << offMap[tmp][0] << " " << offMap[tmp][1]
-                       << " " << offMap[tmp][2] << " " << sipmChannel << " " << nSiPMs
-                       << " " << nSides << " " << test << endl
-                       << detID << " " << sipm_number << " " << QDC << " " << TDC;
-                       
-           if (test>0 || detID%1000>200 || sipm_number>15)
-           {
-             cout << "what goes wrong? " << detID << " SiPM " << sipm_number << " system " << system
-                  << " key " << key << " board " << board_name << " tofperID " << tofpet_id
-                  << " tofperChannel " << tofpet_channel << " test " << test << endl;
-           }
-           t5 = high_resolution_clock::now();
-           counters["createMufi"]+= duration_cast<nanoseconds>(t5 - t4).count();
-       } // end MuFilter encoding
-       
-       else // now Scifi encoding
-       {
-           chan = channel_func(tofpet_id, tofpet_channel, mat);
-           orientation = 1;
-           if (station[2]=='Y') orientation = 0;
-           sipmLocal = (chan - mat*512);
-           sipmID = 1000000*int(station[1]-'0') + 100000*orientation + 10000*mat
-                                            + 1000*(int(sipmLocal/128)) + chan%128;
-           if (digiSciFiStore.count(sipmID)==0)
-           {
-             digiSciFiStore[sipmID] =  new sndScifiHit(sipmID);             
-           }
-           digiSciFiStore[sipmID]->SetDigi(QDC,TDC);
-           digiSciFiStore[sipmID]->SetDaqID(0, board_id, tofpet_id, tofpet_channel);
-           if (mask) digiSciFiStore[sipmID]->setInvalid();
-           LOG (info) << "create scifi hit: tdc = " << board_name << " " << sipmID
-                       << " " << QDC << " " << TDC <<endl
-                       << "tofpet:" << " " << tofpet_id << " " << tofpet_channel << " " << mat
-                       << " " << chan << endl
-                       << station[1] << " " << station[2] << " " << mat << " " << chan
-                       << " " << int(chan/128)%4 << " " << chan%128;
-           t5 = high_resolution_clock::now();
-           counters["createScifi"]+= duration_cast<nanoseconds>(t5 - t4).count();
-       } // end Scifi encoding
+       board_id = s.hits.boardId[n];
+       if (!ConvertHit(s, board_id, s.hits, n)) break;
   } // end loop over hits in event
 
-  counters["N"]+= 1;
   t6 = high_resolution_clock::now();
-  for (auto it_sipmID : digiSciFiStore)
+  StoreHits(s);
+  s.timing.Add(StageTimer::kStorage, duration_cast<nanoseconds>(high_resolution_clock::now() - t6).count());
+  s.timing.Add(StageTimer::kEvent, duration_cast<nanoseconds>(high_resolution_clock::now() - tE).count());
+  //timer.Stop();
+  //cout<<timer.RealTime()<<endl;
+    
+  LOG (info) << fnStart+1 << " events processed out of "
+             << s.eventTree->GetEntries() << " number of events in file.";
+}
+
+bool ConvRawData::ConvertHit(ConvState& s, int board_id, const RawHitArrays& hits, int n)
+{
+  bool mask = false;
+  int tofpet_id{}, tofpet_channel{}, tac{};
+  double TDC{}, QDC{}, Chi2ndof{}, satur{};
+  int A{};
+  double B{};
+  high_resolution_clock::time_point t0{}, t1{}, t4{}, t5{};
+  double test{};
+
+  tofpet_id = hits.tofpetId[n];
+  tofpet_channel = hits.tofpetChannel[n];
+  // Decoded detector channel, precomputed from the board mapping
+  const DaqChannel& ch = daqChannel(board_id, tofpet_id, tofpet_channel);
+  if (!ch.known)
   {
-    (*fDigiSciFi)[indexSciFi]=digiSciFiStore[it_sipmID.first];
-    indexSciFi+= 1;
+    LOG (error) << "board_" << board_id << " not known. Serious error, stop!";
+    return false;
   }
-  for (auto it_detID : digiMuFilterStore)
+  if (!ch.mapped)
   {
-    (*fDigiMuFilter)[indexMuFilter]=digiMuFilterStore[it_detID.first];
-    indexMuFilter+= 1;
+    LOG (error) << "board_" << board_id << " tofpet " << tofpet_id << " not connected in the board mapping, hit skipped";
+    return true;
+  }
+  TRACE_HIT << "In scifi? " << ch.scifi 
+             << " " << board_id << " " << hits.tofpetId[n]
+             << " " << hits.tofpetChannel[n]
+             << " " << hits.tac[n]
+             << " " << hits.tCoarse[n]
+             << " " << hits.tFine[n]
+             << " " << hits.vCoarse[n]
+             << " " << hits.vFine[n];
+  t0 = high_resolution_clock::now();
+  tac = hits.tac[n];
+  /* Since run 39 calibration is done online and 
+  calib data stored in root raw data file */
+  if (makeCalibration)
+    tie(TDC,QDC,Chi2ndof,satur) = comb_calibration(board_id, tofpet_id, tofpet_channel, tac,
+                                              hits.vCoarse[n],
+                                              hits.vFine[n],
+                                              hits.tCoarse[n],
+                                              hits.tFine[n],
+                                              1.0, 0);
+  else
+  {
+    TDC = hits.timestamp[n];
+    QDC = hits.value[n];
+    Chi2ndof = 1;
+    satur = 0.;
+    //Chi2ndof = max(timestampCalChi2[n]/timestampCalDof[n], valueCalChi2[n]/valueCalDof[n]);
+    // FIXME, valueCalDof is a boolean that is true if v_fine/par[d] is above saturationLimit              
+    //satur = (valueCalDof[n] == 1) ? 1.1*saturationLimit : 0.9*saturationLimit;    
+  }
+
+  // Print a warning if TDC or QDC is nan.        
+  if ( TDC != TDC || QDC!=QDC) {
+  LOG (warning) << "NAN tdc/qdc detected! Check maps!"
+                << " " << board_id << " " << hits.tofpetId[n]
+                << " " << hits.tofpetChannel[n]
+                << " " << hits.tac[n]
+                << " " << hits.tCoarse[n]
+                << " " << hits.tFine[n]
+                << " " << hits.vCoarse[n]
+                << " " << hits.vFine[n];
   }
-  counters["storage"]+= duration_cast<nanoseconds>(high_resolution_clock::now() - t6).count();
-  counters["event"]+= duration_cast<nanoseconds>(high_resolution_clock::now() - tE).count();
-  //timer.Stop();
-  //cout<<timer.RealTime()<<endl;
     
-  LOG (info) << fnStart+1 << " events processed out of "
-             << fEventTree->GetEntries() << " number of events in file.";
-  /*
-  cout << "Monitor computing time:" << endl;
-  for (auto it: counters)
+  t1 = high_resolution_clock::now();
+  if ( Chi2ndof > chi2Max )
   {
-     if( it.first=="N" )
-     {
-       cout << "Processed " << it.first<< " = " << it.second << " events." << endl;
-     }
-     else
-     {
-       // Print execution time in seconds
-       cout << "stage " << it.first<< " took " << it.second*1e-9 << " [s]" << endl;
-     }
+    if (QDC>1E20) QDC = 997.; // checking for inf
+    if (QDC != QDC) QDC = 998.; // checking for nan
+    if (QDC>0) QDC = -QDC;
+    mask = true;
   }
-  */
-}
+  else if (satur > saturationLimit || QDC>1E20 || QDC != QDC)
+  {
+    if (QDC>1E20) QDC = 987.; // checking for inf
+    TRACE_HIT << "inf " << board_id << " " << hits.tofpetId[n]    
+               << " " << hits.tofpetChannel[n]
+               << " " << hits.tac[n] 
+               << " " << hits.vCoarse[n]
+               << " " << hits.vFine[n]
+               << " " << TDC-hits.tCoarse[n] 
+               << " " << s.eventNumber << " " << Chi2ndof;
+    if (QDC != QDC) QDC = 988.; // checking for nan
+    TRACE_HIT << "nan " << board_id << " " << hits.tofpetId[n]
+                << " " << hits.tofpetChannel[n]
+                << " " << hits.tac[n]
+                << " " << hits.vCoarse[n]
+                << " " << hits.vFine[n]
+                << " " << TDC-hits.tCoarse[n]
+                << " " << TDC << " " << hits.tCoarse[n]
+                << " " << s.eventNumber << " " << Chi2ndof;
+    A = int(min(QDC,double(1000.)));
+    B = min(satur,double(999.))/1000.;
+    QDC = A+B;
+    mask = true;
+  }
+  else if ( Chi2ndof > chi2Max )
+  {
+     if (QDC>0) QDC = -QDC;
+     mask = true;
+  }         
+  TRACE_HIT << "calibrated: tdc = " << TDC << ", qdc = " << QDC;//TDC clock cycle = 160 MHz or 6.25ns
+  t4 = high_resolution_clock::now();
+  // Set the unit of the execution time measurement to ns
+  s.timing.Add(StageTimer::kCalib, duration_cast<nanoseconds>(t1 - t0).count());
+  s.timing.Add(StageTimer::kMake, duration_cast<nanoseconds>(t4 - t0).count());
   
+  // MuFilter encoding
+  if (!ch.scifi)
+  {
+      TRACE_HIT << ch.system << " " << (tofpet_id%2)*1000 + tofpet_channel << " board_" << board_id
+                << " " << tofpet_id << " " << tofpet_id%2 << " " << tofpet_channel;
+      if (ch.noSiPM) printMissingSiPM(board_id, tofpet_id, tofpet_channel, ch.system);
+      // hits are constructed in place in the output array, one per detID and event
+      int& index = s.muFilterIndex[ch.slot];
+      if (index < 0)
+      {
+        index = s.digiMuFilter->GetEntriesFast();
+        new ((*s.digiMuFilter)[index]) MuFilterHit(ch.detID,ch.nSiPMs,ch.nSides);
+        s.muFilterSlots.push_back(ch.slot);
+      }
+      MuFilterHit* muHit = static_cast<MuFilterHit*>(s.digiMuFilter->UncheckedAt(index));
+      test = muHit->GetSignal(ch.sipm);
+      muHit->SetDigi(QDC,TDC,ch.sipm);
+      muHit->SetDaqID(ch.sipm, board_id, tofpet_id, tofpet_channel);
+      if (mask) muHit->SetMasked(ch.sipm);
+      
+      TRACE_HIT << "create mu hit: " << ch.detID << " " << mufiPlanes[ch.plane] << " " << ch.system
+                  << " " << tofpet_id << " " << ch.nSiPMs << " " << ch.nSides << " " << test << endl
+                  << ch.detID << " " << ch.sipm << " " << QDC << " " << TDC;
+                  
+      if (test>0 || ch.detID%1000>200 || ch.sipm>15)
+      {
+        cout << "what goes wrong? " << ch.detID << " SiPM " << ch.sipm << " system " << ch.system
+             << " key " << (tofpet_id%2)*1000 + tofpet_channel << " board board_" << board_id
+             << " tofperID " << tofpet_id << " tofperChannel " << tofpet_channel << " test " << test << endl;
+      }
+      t5 = high_resolution_clock::now();
+      s.timing.Add(StageTimer::kCreateMufi, duration_cast<nanoseconds>(t5 - t4).count());
+  } // end MuFilter encoding
+  
+  else // now Scifi encoding
+  {
+      int& index = s.sciFiIndex[ch.slot];
+      if (index < 0)
+      {
+        index = s.digiSciFi->GetEntriesFast();
+        new ((*s.digiSciFi)[index]) sndScifiHit(ch.detID);
+        s.sciFiSlots.push_back(ch.slot);
+      }
+      sndScifiHit* scifiHit = static_cast<sndScifiHit*>(s.digiSciFi->UncheckedAt(index));
+      scifiHit->SetDigi(QDC,TDC);
+      scifiHit->SetDaqID(0, board_id, tofpet_id, tofpet_channel);
+      if (mask) scifiHit->setInvalid();
+      TRACE_HIT << "create scifi hit: tdc = board_" << board_id << " " << ch.detID
+                  << " " << QDC << " " << TDC <<endl
+                  << "tofpet:" << " " << tofpet_id << " " << tofpet_channel;
+      t5 = high_resolution_clock::now();
+      s.timing.Add(StageTimer::kCreateScifi, duration_cast<nanoseconds>(t5 - t4).count());
+  } // end Scifi encoding
+  return true;
+}
+
+void ConvRawData::StoreHits(ConvState& s)
+{
+  // Release the slots used in this event
+  for (int slot : s.sciFiSlots) s.sciFiIndex[slot] = -1;
+  for (int slot : s.muFilterSlots) s.muFilterIndex[slot] = -1;
+  s.sciFiSlots.clear();
+  s.muFilterSlots.clear();
+  // Output ordered by detector ID, as with the previous map-based stores
+  s.digiSciFi->Sort();
+  s.digiMuFilter->Sort();
+}
+
 /* https://gitlab.cern.ch/snd-scifi/software/-/wikis/Raw-data-format 
       tac: 0-3, identifies the Time-To-Analogue converter used for this hit (each channel has four of them and they require separate calibration).
       t_coarse: Coarse timestamp of the hit, running on a 4 times the LHC clock
@@ -866,53 +946,195 @@ void ConvRawData::DetMapping(string Path)
     offMap[Form("US_%iRight",i)] = {20000 + (i-1)*1000+ 9, -8, 2};
   }  
 }
+/** Conversion timing **/
+void ConvRawData::StageTimer::Add(Stage stage, int64_t ns)
+{
+  int bin = 0;
+  while (bin < kNBins-1 && (ns >> (bin+1)) > 0) bin++;
+  total[stage]+= ns;
+  calls[stage]+= 1;
+  bins[stage][bin]+= 1;
+}
+void ConvRawData::StageTimer::Merge(const StageTimer& other)
+{
+  for (int st = 0; st < kNStages; st++)
+  {
+    total[st]+= other.total[st];
+    calls[st]+= other.calls[st];
+    for (int bin = 0; bin < kNBins; bin++) bins[st][bin]+= other.bins[st][bin];
+  }
+}
+void ConvRawData::StageTimer::Print() const
+{
+  const char* names[kNStages] = {"event", "calibration", "make", "createScifi", "createMufi", "storage"};
+  for (int st = 0; st < kNStages; st++)
+  {
+    if (calls[st] == 0) continue;
+    // median and 99% quantile as upper edges of the histogram bins
+    long sum = 0;
+    double q50 = -1, q99 = -1;
+    for (int bin = 0; bin < kNBins; bin++)
+    {
+      sum+= bins[st][bin];
+      if (q50 < 0 && sum >= 0.5*calls[st]) q50 = pow(2., bin+1);
+      if (q99 < 0 && sum >= 0.99*calls[st]) q99 = pow(2., bin+1);
+    }
+    LOG (info) << "stage " << names[st] << ": " << calls[st] << " calls, "
+               << total[st]*1e-9 << " [s], mean " << total[st]/calls[st] << " [ns], median < "
+               << q50 << " [ns], 99% < " << q99 << " [ns]";
+  }
+}
+/** Compile the board mapping into the flat channel decoding table **/
+void ConvRawData::buildDaqChannels()
+{
+  int board_id{}, maxBoard = -1;
+  for (auto& sys : boardMaps)
+    for (auto& board : sys.second)
+      maxBoard = max(maxBoard, stoi(board.first.substr(board.first.find("_")+1)));
+  nMapBoards = maxBoard+1;
+  daqChannels.assign(nMapBoards*kNTofpets*kNChannels, DaqChannel{});
+  mufiPlanes.clear();
+  map<string, int> planeIndex{};
+  // dense hit slot per detector ID, used to find the hit of a channel in the event
+  map<int, int> sciFiSlot{}, muFilterSlot{};
+  
+  int mat{}, orientation{}, chan{}, sipmLocal{}, key{}, sipmChannel{}, direction{};
+  string station, tmp;
+  for (auto& board : constAt(boardMaps, "Scifi"))
+  {
+    board_id = stoi(board.first.substr(board.first.find("_")+1));
+    for (auto it : board.second)
+    {
+      station = it.first;
+      mat = it.second;
+    }
+    orientation = 1;
+    if (station[2]=='Y') orientation = 0;
+    for (int tofpet_id = 0; tofpet_id < kNTofpets; tofpet_id++)
+    for (int tofpet_channel = 0; tofpet_channel < kNChannels; tofpet_channel++)
+    {
+      DaqChannel& ch = daqChannels[(board_id*kNTofpets + tofpet_id)*kNChannels + tofpet_channel];
+      chan = channel_func(tofpet_id, tofpet_channel, mat);
+      sipmLocal = (chan - mat*512);
+      ch.known = true;
+      ch.mapped = true;
+      ch.scifi = true;
+      ch.detID = 1000000*int(station[1]-'0') + 100000*orientation + 10000*mat
+                 + 1000*(int(sipmLocal/128)) + chan%128;
+      ch.slot = sciFiSlot.emplace(ch.detID, sciFiSlot.size()).first->second;
+    }
+  }
+  for (auto& board : constAt(boardMaps, "MuFilter"))
+  {
+    board_id = stoi(board.first.substr(board.first.find("_")+1));
+    for (int tofpet_id = 0; tofpet_id < kNTofpets; tofpet_id++)
+    {
+      tmp = constAt(constAt(constAt(boardMapsMu, "MuFilter"), board.first), constAt(slots, tofpet_id));
+      const vector<int>& off = constAt(offMap, tmp);
+      for (int tofpet_channel = 0; tofpet_channel < kNChannels; tofpet_channel++)
+      {
+        DaqChannel& ch = daqChannels[(board_id*kNTofpets + tofpet_id)*kNChannels + tofpet_channel];
+        ch.known = true;
+        ch.scifi = false;
+        ch.mapped = (off.size() == 3);
+        if (!ch.mapped) continue;
+        if (planeIndex.count(tmp) == 0)
+        {
+          planeIndex[tmp] = mufiPlanes.size();
+          mufiPlanes.push_back(tmp);
+        }
+        ch.plane = planeIndex[tmp];
+        ch.system = constAt(constAt(MufiSystem, board_id), tofpet_id);
+        key = (tofpet_id%2)*1000 + tofpet_channel;
+        sipmChannel = 99;
+        ch.noSiPM = (constAt(TofpetMap, ch.system).count(key) == 0);
+        if (!ch.noSiPM) sipmChannel = constAt(constAt(TofpetMap, ch.system), key)-1;
+        ch.nSiPMs = abs(off[1]);
+        ch.nSides = abs(off[2]);
+        direction = int(off[1]/ch.nSiPMs);
+        ch.detID = off[0] + direction*int(sipmChannel/ch.nSiPMs);
+        ch.sipm = sipmChannel%(ch.nSiPMs);
+        if ( tmp.find("Right") != string::npos ) ch.sipm+= ch.nSiPMs;
+        ch.slot = muFilterSlot.emplace(ch.detID, muFilterSlot.size()).first->second;
+      }
+    }
+  }
+  nSciFiSlots = sciFiSlot.size();
+  nMuFilterSlots = muFilterSlot.size();
+}
+void ConvRawData::printMissingSiPM(int board_id, int tofpet_id, int tofpet_channel, int system)
+{
+  int key = (tofpet_id%2)*1000 + tofpet_channel;
+  cout << "key " << key << " does not exist. " << endl
+       << "board_" << board_id << " Tofpet id " << tofpet_id
+       << " System " << system << " has Tofpet map elements: {";
+  for ( auto it : constAt(TofpetMap, system))
+  {
+    cout << it.first << " : " << it.second << ", ";
+  }
+  cout << "}\n";
+}
 /* Define calibration functions **/
+const ConvRawData::QdcCalPar& ConvRawData::qdcPar( int board_id, int tofpet_id, int channel, int tac ) const
+{
+    static const QdcCalPar empty{};
+    int i = calIndex(board_id, tofpet_id, channel, tac);
+    return (i < 0) ? empty : X_qdc[i];
+}
+const ConvRawData::TdcCalPar& ConvRawData::tdcPar( int board_id, int tofpet_id, int channel,
+                                                   int tac, int TDC ) const
+{
+    static const TdcCalPar empty{};
+    int i = calIndex(board_id, tofpet_id, channel, tac);
+    if (i < 0 || TDC < 0 || TDC >= kNTdcs) return empty;
+    return X_tdc[i*kNTdcs + TDC];
+}
 double ConvRawData::qdc_calibration( int board_id, int tofpet_id, int channel,
                        int tac, uint16_t v_coarse, uint16_t v_fine, uint16_t tf )
   {
     double GQDC = 1.0; // or 3.6
-    map<string, double> par= X_qdc[{board_id,tofpet_id,channel,tac}];
+    const QdcCalPar& par = qdcPar(board_id, tofpet_id, channel, tac);
     double x = v_coarse - tf;
-    double fqdc = -par["c"]*log(1+exp( par["a"]*pow((x-par["e"]),2)
-                 -par["b"]*(x-par["e"]) )) + par["d"];
+    double fqdc = -par.c*log(1+exp( par.a*pow((x-par.e),2)
+                 -par.b*(x-par.e) )) + par.d;
     double value = (v_fine-fqdc)/GQDC;
     return value;
 }
 double ConvRawData::qdc_chi2( int board_id, int tofpet_id, int channel, int tac, int TDC=0 )
 {
-    map<string, double> par = X_qdc[{board_id,tofpet_id,channel,tac}];
-    map<string, double> parT = X_tdc[{board_id,tofpet_id,channel,tac, TDC}];
-    return max(par["chi2Ndof"],parT["chi2Ndof"]);
+    const QdcCalPar& par = qdcPar(board_id, tofpet_id, channel, tac);
+    const TdcCalPar& parT = tdcPar(board_id, tofpet_id, channel, tac, TDC);
+    return max(par.chi2Ndof, parT.chi2Ndof);
 }
 double ConvRawData::qdc_sat( int board_id, int tofpet_id, int channel, int tac, uint16_t v_fine )
 {
-    map<string, double> par = X_qdc[{board_id,tofpet_id,channel,tac}];
-    return v_fine/par["d"];  
+    const QdcCalPar& par = qdcPar(board_id, tofpet_id, channel, tac);
+    return v_fine/par.d;
 }
 double ConvRawData::time_calibration( int board_id, int tofpet_id, int channel,
                         int tac, int64_t t_coarse, uint16_t t_fine, int TDC=0 )
 {
-    map<string, double> parT = X_tdc[{board_id,tofpet_id,channel,tac, TDC}];
+    const TdcCalPar& parT = tdcPar(board_id, tofpet_id, channel, tac, TDC);
     double x = t_fine;
-    double ftdc = (-parT["b"]-sqrt(pow(parT["b"],2)
-                  -4*parT["a"]*(parT["c"]-x)))/(2*parT["a"]);
+    double ftdc = (-parT.b-sqrt(pow(parT.b,2)
+                  -4*parT.a*(parT.c-x)))/(2*parT.a);
     double timestamp = t_coarse+ftdc;
     return timestamp;
 }
 tuple<double, double, double, double> ConvRawData::comb_calibration( int board_id, int tofpet_id, int channel,int tac, uint16_t v_coarse, uint16_t v_fine,int64_t t_coarse, uint16_t t_fine, double GQDC = 1.0, int TDC=0 )// max gain QDC = 3.6
 {
-    map<string, double> par= X_qdc[{board_id,tofpet_id,channel,tac}];
-    map<string, double> parT = X_tdc[{board_id,tofpet_id,channel,tac,TDC}];
+    const QdcCalPar& par = qdcPar(board_id, tofpet_id, channel, tac);
+    const TdcCalPar& parT = tdcPar(board_id, tofpet_id, channel, tac, TDC);
     double x    = t_fine;
-    double ftdc = (-parT["b"]-sqrt(pow(parT["b"],2)
-                  -4*parT["a"]*(parT["c"]-x)))/(2*parT["a"]); // Ettore 28/01/2022 +par['d']
+    double ftdc = (-parT.b-sqrt(pow(parT.b,2)
+                  -4*parT.a*(parT.c-x)))/(2*parT.a); // Ettore 28/01/2022 +par['d']
     double timestamp = t_coarse + ftdc;
     double tf = timestamp - t_coarse;
     x = v_coarse - tf;
-    double fqdc = - par["c"]*log(1+exp( par["a"]*pow((x-par["e"]),2)-par["b"]*(x-par["e"]) ))
-                 + par["d"];
+    double fqdc = - par.c*log(1+exp( par.a*pow((x-par.e),2)-par.b*(x-par.e) ))
+                 + par.d;
     double value = (v_fine-fqdc)/GQDC;
-    return make_tuple(timestamp,value,max(par["chi2Ndof"],parT["chi2Ndof"]),v_fine/par["d"]);
+    return make_tuple(timestamp,value,max(par.chi2Ndof,parT.chi2Ndof),v_fine/par.d);
 }
 map<double, pair<double, double> > ConvRawData::calibrationReport()
 {
@@ -920,16 +1142,18 @@ map<double, pair<double, double> > ConvRawData::calibrationReport()
     map<double, pair<double, double> > report{};
     int TDC = 0;
     double chi2{}, chi2T{}, key{};
-    // loop over entries of X_qdc and get map keys
-    for (auto it : X_qdc)
+    // loop over all table entries that were filled from the csv files
+    for (int b = 0; b < nCalBoards; b++)
+    for (int t = 0; t < kNTofpets; t++)
+    for (int c = 0; c < kNChannels; c++)
+    for (int tac = 0; tac < kNTacs; tac++)
     {
-      map<string, double> par= X_qdc[{it.first[0], it.first[1], it.first[2], it.first[3]}];
-      if (par["chi2Ndof"]) chi2 = par["chi2Ndof"];
-      else chi2 = -1;
-      map<string, double> parT = X_tdc[{it.first[0], it.first[1], it.first[2], it.first[3], TDC}];
-      if (parT["chi2Ndof"]) chi2T = parT["chi2Ndof"];
-      else chi2T = -1;
-      key = it.first[3] +10*it.first[2] + it.first[1]*10*100 + it.first[0]*10*100*100;
+      const QdcCalPar& par = qdcPar(b, t, c, tac);
+      const TdcCalPar& parT = tdcPar(b, t, c, tac, TDC);
+      if (!par.chi2Ndof && !parT.chi2Ndof) continue;
+      chi2 = (par.chi2Ndof) ? par.chi2Ndof : -1;
+      chi2T = (parT.chi2Ndof) ? parT.chi2Ndof : -1;
+      key = tac +10*c + t*10*100 + b*10*100*100;
       if (report.count(key)==0) report[key] = make_pair(chi2,chi2T);
     }
     for (auto it : report)
@@ -946,7 +1170,7 @@ int ConvRawData::channel_func( int tofpet_id, int tofpet_channel, int position)
     return (64*tofpet_id + 63 - tofpet_channel + 512*position);// 512 channels per mat, 1536 channels per plane. One channel covers all 6 layers of fibres.
 }
 /** Read csv data files **/
-void ConvRawData::read_csv(string Path)
+void ConvRawData::readCalibrationCsv(string Path)
 {
   ifstream infile; // ifstream is the stream class to only read! from files.
   stringstream X;
@@ -959,8 +1183,10 @@ void ConvRawData::read_csv(string Path)
   uint32_t bytesRead = 0;
   string line, element;
   double chi2_Ndof{};
-  // counter of number of elements
-  vector<int> key_vector{};
+  // rows are kept until the largest board id is known, then copied into the tables
+  vector<pair<array<int, 5>, QdcCalPar> > qdcRows{};
+  vector<pair<array<int, 5>, TdcCalPar> > tdcRows{};
+  int maxBoard = -1;
   
   // Get QDC calibration data
   if (local)
@@ -1001,12 +1227,11 @@ void ConvRawData::read_csv(string Path)
       if(iscntrl(element[0])) break;
       qdcData.push_back(stof(element));
     }
-    if (qdcData.size()<10) continue;
-    key_vector.clear();
-    key_vector = {int(qdcData[0]), int(qdcData[1]), int(qdcData[2]), int(qdcData[3])};
+    if (qdcData.size()<11) continue;
     chi2_Ndof = (qdcData[9] < 2) ? 999999. : qdcData[7]/qdcData[9]; 
-    X_qdc[key_vector] = { {"a",qdcData[4]}, {"b",qdcData[5]}, {"c",qdcData[6]},
-                          {"d",qdcData[8]}, {"e",qdcData[10]}, {"chi2Ndof",chi2_Ndof} };
+    qdcRows.push_back({ {int(qdcData[0]), int(qdcData[1]), int(qdcData[2]), int(qdcData[3]), 0},
+                        {qdcData[4], qdcData[5], qdcData[6], qdcData[8], qdcData[10], chi2_Ndof} });
+    maxBoard = max(maxBoard, int(qdcData[0]));
     if (X.peek() == EOF) break;
   }
   X.str(string()); X.clear(); line.clear();
@@ -1050,17 +1275,158 @@ void ConvRawData::read_csv(string Path)
       if(iscntrl(element[0])) break;
       tdcData.push_back(stof(element));
     }
-    if (tdcData.size()<9) continue;
-    key_vector.clear();
-    key_vector = {int(tdcData[0]), int(tdcData[1]), int(tdcData[2]), int(tdcData[3]), int(tdcData[4])};
+    if (tdcData.size()<11) continue;
     chi2_Ndof = (tdcData[10] < 2) ? 999999. : tdcData[8]/tdcData[10]; 
-    X_tdc[key_vector] = { {"a",tdcData[5]}, {"b",tdcData[6]}, {"c",tdcData[7]},
-                          {"d",tdcData[9]}, {"chi2Ndof",chi2_Ndof} };
+    tdcRows.push_back({ {int(tdcData[0]), int(tdcData[1]), int(tdcData[2]), int(tdcData[3]), int(tdcData[4])},
+                        {tdcData[5], tdcData[6], tdcData[7], tdcData[9], chi2_Ndof} });
+    maxBoard = max(maxBoard, int(tdcData[0]));
     if (X.peek() == EOF) break;
   }
   X.str(string()); X.clear(); line.clear();
   size = 0; offset = 0; bytesRead = 0;
-  
+
+  // Fill the dense calibration tables
+  nCalBoards = maxBoard+1;
+  X_qdc.assign(nCalBoards*kNTofpets*kNChannels*kNTacs, QdcCalPar{});
+  X_tdc.assign(nCalBoards*kNTofpets*kNChannels*kNTacs*kNTdcs, TdcCalPar{});
+  int idx{};
+  for (auto& row : qdcRows)
+  {
+    idx = calIndex(row.first[0], row.first[1], row.first[2], row.first[3]);
+    if (idx < 0)
+    {
+      LOG (warning) << "QDC calibration entry out of range: " << row.first[0] << " "
+                    << row.first[1] << " " << row.first[2] << " " << row.first[3];
+      continue;
+    }
+    X_qdc[idx] = row.second;
+  }
+  for (auto& row : tdcRows)
+  {
+    idx = calIndex(row.first[0], row.first[1], row.first[2], row.first[3]);
+    if (idx < 0 || row.first[4] < 0 || row.first[4] >= kNTdcs)
+    {
+      LOG (warning) << "TDC calibration entry out of range: " << row.first[0] << " "
+                    << row.first[1] << " " << row.first[2] << " " << row.first[3]
+                    << " " << row.first[4];
+      continue;
+    }
+    X_tdc[idx*kNTdcs + row.first[4]] = row.second;
+  }
+}
+/** Size and modification time of the calibration csv files, used to validate the cache **/
+bool ConvRawData::calibrationStamp(string Path, uint64_t stamp[4])
+{
+  const char* names[2] = {"qdc_cal.csv", "tdc_cal.csv"};
+  for (int i = 0; i < 2; i++)
+  {
+    string fname = Form("%s/%s", Path.c_str(), names[i]);
+    if (local)
+    {
+      struct stat buffer;
+      if (stat(fname.c_str(), &buffer) != 0) return false;
+      stamp[2*i] = buffer.st_size;
+      stamp[2*i+1] = buffer.st_mtime;
+    }
+    else
+    {
+      File file;
+      StatInfo *info = nullptr;
+      if (!file.Open(fname, OpenFlags::Read).IsOK()) return false;
+      XRootDStatus status = file.Stat(false, info);
+      file.Close();
+      if (!status.IsOK() || !info) return false;
+      stamp[2*i] = info->GetSize();
+      stamp[2*i+1] = info->GetModTime();
+      delete info;
+    }
+  }
+  return true;
+}
+/** Cache file of a calibration directory, in $SNDSW_CALIB_CACHE or the temp directory **/
+string ConvRawData::calibrationCacheFile(string Path)
+{
+  string dir;
+  const char* env = gSystem->Getenv("SNDSW_CALIB_CACHE");
+  if (env && *env) dir = env;
+  else dir = Form("%s/sndsw_calib_cache", gSystem->TempDirectory());
+  return Form("%s/calib_%016llx.bin", dir.c_str(),
+              (unsigned long long)fnv1a(Path.data(), Path.size()));
+}
+bool ConvRawData::readCalibrationCache(string Path, const uint64_t stamp[4])
+{
+  string fname = calibrationCacheFile(Path);
+  ifstream in(fname, ios::binary);
+  if (!in) return false;
+  CalibCacheHeader h{};
+  in.read(reinterpret_cast<char*>(&h), sizeof(h));
+  if (!in || memcmp(h.magic, kCalibCacheMagic, sizeof(h.magic)) != 0
+      || h.version != kCalibCacheVersion || h.nBoards < 0
+      || memcmp(h.stamp, stamp, sizeof(h.stamp)) != 0
+      || h.nQdc != uint64_t(h.nBoards)*kNTofpets*kNChannels*kNTacs
+      || h.nTdc != h.nQdc*kNTdcs)
+  {
+    LOG (info) << "Calibration cache " << fname << " is stale, reading csv files";
+    return false;
+  }
+  vector<QdcCalPar> qdc(h.nQdc);
+  vector<TdcCalPar> tdc(h.nTdc);
+  in.read(reinterpret_cast<char*>(qdc.data()), qdc.size()*sizeof(QdcCalPar));
+  in.read(reinterpret_cast<char*>(tdc.data()), tdc.size()*sizeof(TdcCalPar));
+  if (!in) return false;
+  uint64_t sum = fnv1a(qdc.data(), qdc.size()*sizeof(QdcCalPar));
+  sum = fnv1a(tdc.data(), tdc.size()*sizeof(TdcCalPar), sum);
+  if (sum != h.checksum)
+  {
+    LOG (warning) << "Calibration cache " << fname << " is corrupted, reading csv files";
+    return false;
+  }
+  nCalBoards = h.nBoards;
+  X_qdc.swap(qdc);
+  X_tdc.swap(tdc);
+  LOG (info) << "Read calibration constants from cache " << fname;
+  return true;
+}
+void ConvRawData::writeCalibrationCache(string Path, const uint64_t stamp[4])
+{
+  string fname = calibrationCacheFile(Path);
+  gSystem->mkdir(gSystem->DirName(fname.c_str()), kTRUE);
+  CalibCacheHeader h{};
+  memcpy(h.magic, kCalibCacheMagic, sizeof(h.magic));
+  h.version = kCalibCacheVersion;
+  h.nBoards = nCalBoards;
+  memcpy(h.stamp, stamp, sizeof(h.stamp));
+  h.nQdc = X_qdc.size();
+  h.nTdc = X_tdc.size();
+  h.checksum = fnv1a(X_qdc.data(), X_qdc.size()*sizeof(QdcCalPar));
+  h.checksum = fnv1a(X_tdc.data(), X_tdc.size()*sizeof(TdcCalPar), h.checksum);
+  // Write to a private file and rename, concurrent jobs never see a partial cache
+  string tmpName = Form("%s.%d", fname.c_str(), gSystem->GetPid());
+  ofstream out(tmpName, ios::binary);
+  out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  out.write(reinterpret_cast<const char*>(X_qdc.data()), X_qdc.size()*sizeof(QdcCalPar));
+  out.write(reinterpret_cast<const char*>(X_tdc.data()), X_tdc.size()*sizeof(TdcCalPar));
+  out.close();
+  if (!out || rename(tmpName.c_str(), fname.c_str()) != 0)
+  {
+    LOG (warning) << "Could not write calibration cache " << fname;
+    gSystem->Unlink(tmpName.c_str());
+  }
+}
+void ConvRawData::read_csv(string Path)
+{
+  // Calibration constants, from the binary cache if it matches the csv files
+  uint64_t stamp[4]{};
+  bool stamped = calibrationStamp(Path, stamp);
+  if (!stamped || !readCalibrationCache(Path, stamp))
+  {
+    readCalibrationCsv(Path);
+    if (stamped) writeCalibrationCache(Path, stamp);
+  }
+
+  ifstream infile; // ifstream is the stream class to only read! from files.
+  stringstream X;
+  string line, element;
   int SiPM{};
   vector<int> data_vector{};
   map<string, map<int, vector<int>> > SiPMmap{};
@@ -1101,7 +1467,6 @@ void ConvRawData::read_csv(string Path)
         if (X.peek() == EOF) break;
     }
     X.str(string()); X.clear(); line.clear();
-    size = 0; offset = 0; bytesRead = 0;
     for (auto channel : SiPMmap[sys.first])
     {
       row = channel.second;
@@ -9,10 +9,16 @@
 #include "Scifi.h"              // for Scifi detector
 #include "sndScifiHit.h"	// for SciFi Hit
 #include "MuFilterHit.h"	// for Muon Filter Hit
+#include "RawLeafArray.h"        // for bound input leaves
 
 #include <iostream>
 #include <tuple>
 #include <map>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <functional>
 
 using namespace std;
 
@@ -31,10 +37,95 @@ class ConvRawData : public FairTask
     /** Virtual method Exec **/
     virtual void Exec(Option_t* opt);
 
+    /** Virtual method Finish, prints the conversion timing **/
+    virtual void Finish();
+
+    /** Switch the per-hit trace output on or off, also while converting.
+        Only effective when built with CONVRAWDATA_TRACE, it is compiled out otherwise. **/
+    void SetHitTrace(bool on) { fTraceHits.store(on, std::memory_order_relaxed); }
+
     /** Update input raw-data file and first-to-process event **/
     void UpdateInput(int n);
 
+    /** Convert events [nStart, nEvents) on nThreads workers instead of FairRunAna::Run.
+        Each worker reads its own event range with its own state; the output
+        of the workers is merged in event order into outFile. Returns false,
+        and writes no outFile, if any event range could not be converted. **/
+    bool RunParallel(int nThreads, string outFile);
+
+    /** Follow mode for online monitoring. Entries appended to the input while
+        it is being written are converted as they appear, calibration and
+        mapping stay as loaded by Init. After each event the callback gets the
+        event number within the partition; the header and hit arrays
+        registered in Init then hold that event. Followed events are not
+        persisted: they are not filled into the output tree and get no entry
+        in EventTags. **/
+    void SetEventCallback(function<void(int)> callback) { fEventCallback = callback; }
+    /** Convert the entries added to the input since the last call, at most
+        maxEvents if positive. Returns the number of events converted. **/
+    int ConvertNew(int maxEvents = -1);
+    /** Poll the input every pollMs ms and convert new entries, until StopFollow
+        or no new entry for idleTimeout s (forever if not positive). Once the
+        current partition data_NNNN.root has no new entries and the next one
+        exists, conversion continues with the next partition. **/
+    void Follow(int pollMs = 500, double idleTimeout = -1);
+    /** Stop Follow after the current event, may be called from the callback or another thread **/
+    void StopFollow() { fStopFollow.store(true); }
+
     private:
+      /** Per-stage timing: total, number of calls and a histogram of the
+          call durations in powers of two of ns **/
+      struct StageTimer
+      {
+        enum Stage { kEvent, kCalib, kMake, kCreateScifi, kCreateMufi, kStorage, kNStages };
+        static const int kNBins = 40; // bin i holds durations in [2^i, 2^(i+1)) ns
+        double total[kNStages]{};
+        long calls[kNStages]{};
+        long bins[kNStages][kNBins]{};
+        void Add(Stage stage, int64_t ns);
+        void Merge(const StageTimer& other);
+        void Print() const;
+      };
+
+      /** Event tag of one converted event, new format only. The tags of a
+          run are written as the flat "EventTags" tree next to the converted
+          tree, one entry per converted entry, so analyses can select entries,
+          e.g. with EventTags->Draw(">>list", "beamMode==11", "entrylist"),
+          before reading any hit branch. **/
+      struct EventTag
+      {
+        int eventNumber;
+        int64_t UTCtimestamp;
+        uint16_t fillNumber;
+        uint8_t accMode, beamMode;
+        uint8_t fastFilters;   // SNDLHCEventHeader::GetFastNoiseFilterBits
+        uint16_t advFilters;   // SNDLHCEventHeader::GetAdvNoiseFilterBits
+      };
+
+      /** Mutable conversion state: input trees and leaves, hit stores, output
+          objects. The task owns one for FairRunAna::Run, every RunParallel
+          worker has its own. Calibration and mapping tables are shared. **/
+      struct ConvState
+      {
+        TTree* eventTree{nullptr};
+        map<string, TTree*> boards{};        // Board_x data, old format
+        RawLeafArray evtTimestamp{}, evtNumber{}, evtFlags{};
+        RawHitArrays hits{};                 // new format, "data" tree
+        map<string, RawHitArrays> boardHits{};
+        // Index of the hit of each detector slot in the output arrays, -1 if none yet
+        vector<int> sciFiIndex{}, muFilterIndex{};
+        vector<int> sciFiSlots{}, muFilterSlots{}; // slots used in the current event
+        // For time monitoring
+        StageTimer timing{};
+        int eventNumber{};
+        FairEventHeader* eventHeader{nullptr};
+        SNDLHCEventHeader* sndEventHeader{nullptr};
+        TClonesArray* digiSciFi{nullptr};
+        TClonesArray* digiMuFilter{nullptr};
+        vector<EventTag> tags{};             // one per converted event
+        bool recordTags{true};               // off while following, nothing is written then
+      };
+
       /** Start time of run **/
       void StartTimeofRun(string path);
       /** Board mapping for Scifi and MuFilter **/
@@ -55,20 +146,81 @@ class ConvRawData : public FairTask
                                                               double GQDC , int TDC);
                                                               // max gain QDC = 3.6
       map<double, pair<double, double> > calibrationReport();
+      /** Plain calibration parameters of one (board, tofpet, channel, tac[, TDC]) **/
+      struct QdcCalPar { double a, b, c, d, e, chi2Ndof; };
+      struct TdcCalPar { double a, b, c, d, chi2Ndof; };
+      /** Dense index into the calibration tables, -1 if out of range **/
+      static const int kNTofpets = 8, kNChannels = 64, kNTacs = 4, kNTdcs = 2;
+      int calIndex(int board_id, int tofpet_id, int channel, int tac) const
+      {
+        if (board_id < 0 || board_id >= nCalBoards || tofpet_id < 0 || tofpet_id >= kNTofpets
+            || channel < 0 || channel >= kNChannels || tac < 0 || tac >= kNTacs) return -1;
+        return ((board_id*kNTofpets + tofpet_id)*kNChannels + channel)*kNTacs + tac;
+      }
+      const QdcCalPar& qdcPar(int board_id, int tofpet_id, int channel, int tac) const;
+      const TdcCalPar& tdcPar(int board_id, int tofpet_id, int channel, int tac, int TDC) const;
+
+      /** Detector channel of one (board, tofpet, tofpet channel), compiled from the board mapping **/
+      struct DaqChannel
+      {
+        bool known;   // board in the mapping
+        bool mapped;  // MuFilter: tofpet slot connected to a plane
+        bool scifi;
+        bool noSiPM;  // MuFilter: no SiPM for this tofpet channel in the SiPM map
+        int detID;    // MuFilter detID or Scifi sipmID
+        int sipm;     // MuFilter sipm number, 0 for Scifi
+        int nSiPMs, nSides;
+        int system;   // MuFilter system: 0 veto, 1 US, 2 DS
+        int plane;    // MuFilter index in mufiPlanes
+        int slot;     // dense index of detID within Scifi or MuFilter
+      };
+      /** Fill daqChannels from the board mapping and SiPM maps **/
+      void buildDaqChannels();
+      const DaqChannel& daqChannel(int board_id, int tofpet_id, int tofpet_channel) const
+      {
+        static const DaqChannel unknown{};
+        if (board_id < 0 || board_id >= nMapBoards || tofpet_id < 0 || tofpet_id >= kNTofpets
+            || tofpet_channel < 0 || tofpet_channel >= kNChannels) return unknown;
+        return daqChannels[(board_id*kNTofpets + tofpet_id)*kNChannels + tofpet_channel];
+      }
+      /** Board in the Scifi or MuFilter mapping, all its channels are then in the table **/
+      bool boardKnown(int board_id) const { return daqChannel(board_id, 0, 0).known; }
+      void printMissingSiPM(int board_id, int tofpet_id, int tofpet_channel, int system);
 
       /** Define some other functions **/
       int channel_func( int tofpet_id, int tofpet_channel, int position);
       /** Read csv data files **/
       void read_csv(string path);
+      void readCalibrationCsv(string path);
+      /** Binary cache of the calibration tables, reused while the csv files are unchanged **/
+      bool calibrationStamp(string path, uint64_t stamp[4]);
+      string calibrationCacheFile(string path);
+      bool readCalibrationCache(string path, const uint64_t stamp[4]);
+      void writeCalibrationCache(string path, const uint64_t stamp[4]);
+      /** Get the input trees from the raw-data file and resolve their leaves **/
+      bool OpenInput(ConvState& s, TFile* f0);
+      bool BindInput(ConvState& s);
       /** Processing of different raw-data formats **/
-      void Process0();
-      void Process1();
+      void ConvertEvent(ConvState& s);
+      void Process0(ConvState& s);
+      void Process1(ConvState& s);
+      /** Calibrate and store one hit, false if the board is not known **/
+      bool ConvertHit(ConvState& s, int board_id, const RawHitArrays& hits, int n);
+      /** Release the hit slots of the event and sort the output arrays **/
+      void StoreHits(ConvState& s);
+      /** Name of the partition after the input file, empty if not of the form data_NNNN.root **/
+      string nextPartition(const string& name);
+      /** Convert events [nFirst, nLast) into partFile, run by each RunParallel worker **/
+      bool ConvertRange(int nFirst, int nLast, string partFile, vector<EventTag>& tags);
+      /** Memory resident "EventTags" tree of the given tags, owned by the caller **/
+      TTree* MakeEventTagTree(const vector<EventTag>& tags);
     
       /** Data structures to be used in the class **/
-      map<int, MuFilterHit* > digiMuFilterStore{};
-      map<int, sndScifiHit* > digiSciFiStore{}; 
-      map<vector<int>, map<string, double> > X_qdc{};
-      map<vector<int>, map<string, double> > X_tdc{};
+      // Calibration constants, filled once by read_csv. Entries missing in the
+      // csv files stay zero, as with the previous map-based lookup.
+      int nCalBoards{};
+      vector<QdcCalPar> X_qdc{}; //!
+      vector<TdcCalPar> X_tdc{}; //!
       map<string, map<string, map<string, int>> > boardMaps{};
       map<int, map<int, int> > MufiSystem{}; // <board_id_mu, <slot(tofpetID), s>
       map<int, string > slots = { {0,"A"}, {1,"A"}, {2,"B"}, {3,"B"},
@@ -76,32 +228,32 @@ class ConvRawData : public FairTask
       map<int, map<int, int> > TofpetMap{};
       map<string, map<string, map<string, string>> > boardMapsMu{};
       map<string, vector<int> > offMap{};// name is key, vector is first bar, number of sipm channels / bar and direction
-      // For time monitoring
-      map<string, double> counters = { {"N",0}, {"event",0}, {"qdc",0}, {"tdc",0}, {"chi2",0},
-                                       {"make",0}, {"storage",0}, {"createScifi",0}, {"createMufi",0} };
+      // Flat channel decoding table, indexed by (board, tofpet, tofpet channel)
+      int nMapBoards{}, nSciFiSlots{}, nMuFilterSlots{};
+      vector<DaqChannel> daqChannels{}; //!
+      vector<string> mufiPlanes{};
   
       Scifi* ScifiDet;
       TFile* fOut;
       /** Input data **/
-      TTree* fEventTree;
-      // Board_x data
-      map<string, TTree*> boards{};
+      string fInputName;
+      ConvState fState; //! state of the serial (FairRunAna) conversion
+      StageTimer fParallelTiming{}; //! merged timing of the RunParallel workers
+      mutex fTimingMutex;           //!
+      atomic<bool> fTraceHits{false}; //!
+      /** Follow mode **/
+      function<void(int)> fEventCallback{}; //!
+      atomic<bool> fStopFollow{false};      //!
+      unique_ptr<TFile> fFollowFile{};      //! partition opened by Follow
       /** Input parameters **/
       int frunNumber;
       int fnStart, fnEvents;
       int fheartBeat;
       int debug, stop, makeCalibration, local, newFormat;
       string fpathCalib, fpathJSON; 
-      int eventNumber;
       double chi2Max, saturationLimit;
       double runStartUTC;
     
-      /** Output data **/
-      SNDLHCEventHeader* fSNDLHCEventHeader;
-      FairEventHeader* fEventHeader;
-      TClonesArray* fDigiSciFi;
-      TClonesArray* fDigiMuFilter;
-    
       ConvRawData(const ConvRawData&);
       ConvRawData& operator=(const ConvRawData&);
 
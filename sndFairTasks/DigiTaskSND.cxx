@@ -24,6 +24,7 @@
  #include "ScifiPoint.h"	     // for SciFi Point
  #include "Scifi.h"	             // for SciFi detector
  #include "MuFilterPoint.h"	     // for Muon Filter Point
+ #include "MuFilter.h"	             // for Muon Filter detector
  #include "sndScifiHit.h"	     // for SciFi Hit
  #include "MuFilterHit.h"	     // for Muon Filter Hit
  #include "sndCluster.h"	     // for Clusters
@@ -57,8 +58,8 @@ InitStatus DigiTaskSND::Init()
     // Get the SciFi detector and sipm to fibre mapping
     scifi = dynamic_cast<Scifi*> (gROOT->GetListOfGlobals()->FindObject("Scifi") );
     scifi->SiPMmapping();
-    fibresSiPM = scifi->GetSiPMmap();
-    siPMFibres = scifi->GetFibresMap();
+    // and the MuFilter detector for the digitisation parameters of its bars
+    mufilter = dynamic_cast<MuFilter*> (gROOT->GetListOfGlobals()->FindObject("MuFilter") );
 
     // Get event header
     fMCEventHeader = static_cast<FairMCEventHeader*> (ioman->GetObject("MCEventHeader."));	
@@ -134,10 +135,13 @@ void DigiTaskSND::digitizeScifi()
     // a map containing fibreID and vector(list) of points and weights
     map<int, pair<vector<ScifiPoint*>, vector<float>> > hitContainer{};
     Hit2MCPoints mcLinks;
-    map<pair<int, int>, double> mcPoints{};
+    // MC points and their energy deposit, grouped per SiPM channel
+    map<int, vector<pair<int, double>> > mcPoints{};
     map<int, double> norm{};
     int globsipmChan{}, detID{};
-    int locFibreID{};
+    int locFibreID{}, nSiPMs{};
+    const Int_t* sipmChans{};
+    const Float_t* sipmWeights{};
     
     // Fill the map
     for (int k = 0, kEnd = fScifiPointArray->GetEntries(); k < kEnd; k++)
@@ -148,34 +152,35 @@ void DigiTaskSND::digitizeScifi()
         detID = point->GetDetectorID();
         locFibreID = detID%100000;
         // Check if locFibreID in a dead area
-        if(siPMFibres.count(locFibreID)==0) continue;
+        nSiPMs = scifi->GetFibreSiPMs(locFibreID, sipmChans, sipmWeights);
+        if (nSiPMs==0) continue;
         double dE{};
         float weight{};
-        for (auto sipmChan : siPMFibres[locFibreID])
+        for (int i = 0; i < nSiPMs; i++)
         {
-            globsipmChan = int(detID/100000)*100000+sipmChan.first;
+            globsipmChan = int(detID/100000)*100000+sipmChans[i];
             // Initializing - not needed in C++
             /*if (hitContainer[globsipmChan].first.size()==0){
                  hitContainer[globsipmChan] = {};
                  mcPoints[make_pair(globsipmChan, k)] = {};
                  norm[globsipmChan] = {};
             }*/
-            weight = sipmChan.second[0];
+            weight = sipmWeights[i];
             hitContainer[globsipmChan].first.push_back(point);
             hitContainer[globsipmChan].second.push_back(weight);
             dE = point->GetEnergyLoss()*weight;
-            mcPoints[make_pair(globsipmChan, k)] = dE;
+            mcPoints[globsipmChan].emplace_back(k, dE);
             norm[globsipmChan]+= dE;
         }
     }// End filling map
     int index = 0;
     // Loop over entries of the hitContainer map and collect all hits in same detector element
     for (auto it = hitContainer.begin(); it != hitContainer.end(); it++){
-        new ((*fScifiDigiHitArray)[index]) sndScifiHit(it->first, hitContainer[it->first].first, hitContainer[it->first].second);
+        new ((*fScifiDigiHitArray)[index]) sndScifiHit(it->first, it->second.first, it->second.second);
         index++;
- 	for (auto mcit = mcPoints.begin(); mcit != mcPoints.end(); mcit++){
-            if(it->first == mcit->first.first) mcLinks.Add(it->first, mcit->first.second, mcPoints[make_pair(it->first, mcit->first.second)]/norm[it->first]);
-        }
+        double chanNorm = norm[it->first];
+        for (auto& mcit : mcPoints[it->first])
+            mcLinks.Add(it->first, mcit.first, mcit.second/chanNorm);
     }
     new((*fScifiHit2MCPointsArray)[0]) Hit2MCPoints(mcLinks);
 }
@@ -234,7 +239,8 @@ void DigiTaskSND::digitizeMuFilter()
     // a map with detID and vector(list) of points
     map<int, vector<MuFilterPoint*> > hitContainer{};
     Hit2MCPoints mcLinks;
-    map<pair<int, int>, double> mcPoints{};
+    // MC points and their energy deposit, grouped per detector element
+    map<int, vector<pair<int, double>> > mcPoints{};
     map<int, double> norm{};
     int detID{};
 
@@ -251,17 +257,17 @@ void DigiTaskSND::digitizeMuFilter()
           norm[detID] = {};
         }*/
         hitContainer[detID].push_back(point);
-        mcPoints[make_pair(detID, k)] = point->GetEnergyLoss();
+        mcPoints[detID].emplace_back(k, point->GetEnergyLoss());
         norm[detID]+= point->GetEnergyLoss();
     }
     int index = 0;
     // Loop over entries of the hitContainer map and collect all hits in same detector element
     for (auto it = hitContainer.begin(); it != hitContainer.end(); it++){
-        /*MuFilterHit* aHit = */new ((*fMuFilterDigiHitArray)[index]) MuFilterHit(it->first, hitContainer[it->first]);
+        /*MuFilterHit* aHit = */new ((*fMuFilterDigiHitArray)[index]) MuFilterHit(it->first, it->second, mufilter->GetDigiPar(it->first));
         index++;
- 	for (auto mcit = mcPoints.begin(); mcit != mcPoints.end(); mcit++){
-            if(it->first == mcit->first.first) mcLinks.Add(it->first, mcit->first.second, mcPoints[make_pair(it->first, mcit->first.second)]/norm[it->first]);
-        }
+        double chanNorm = norm[it->first];
+        for (auto& mcit : mcPoints[it->first])
+            mcLinks.Add(it->first, mcit.first, mcit.second/chanNorm);
     }
     new((*fMuFilterHit2MCPointsArray)[0]) Hit2MCPoints(mcLinks); 
 }
@@ -15,6 +15,7 @@
 #include "FairEventHeader.h"    // for FairEventHeader
 #include "FairMCEventHeader.h"  // for FairMCEventHeader
 #include "Scifi.h"              // for Scifi detector
+#include "MuFilter.h"           // for MuFilter detector
 class TBuffer;
 class TClass;
 class TClonesArray;
@@ -46,8 +47,7 @@ class DigiTaskSND : public FairTask
     void clusterScifi();
 
     Scifi* scifi;
-    map<Int_t, map<Int_t, array<float, 2>>> fibresSiPM;
-    map<Int_t, map<Int_t, array<float, 2>>> siPMFibres;
+    MuFilter* mufilter;
 
     // Input
     FairMCEventHeader* fMCEventHeader;
@@ -0,0 +1,95 @@
+#include <cstring>
+#include "RawLeafArray.h"
+#include "FairLogger.h"
+
+bool RawLeafArray::Bind(TTree* tree, const char* name)
+{
+  fLeaf = tree->GetLeaf(name);
+  fType = kOther;
+  if (!fLeaf)
+  {
+    LOG (error) << "RawLeafArray: leaf " << name << " not found in tree " << tree->GetName();
+    return false;
+  }
+  const char* type = fLeaf->GetTypeName();
+  if      (!strcmp(type, "Bool_t"))    fType = kBool;
+  else if (!strcmp(type, "Char_t"))    fType = kChar;
+  else if (!strcmp(type, "UChar_t"))   fType = kUChar;
+  else if (!strcmp(type, "Short_t"))   fType = kShort;
+  else if (!strcmp(type, "UShort_t"))  fType = kUShort;
+  else if (!strcmp(type, "Int_t"))     fType = kInt;
+  else if (!strcmp(type, "UInt_t"))    fType = kUInt;
+  else if (!strcmp(type, "Long_t"))    fType = kLong;
+  else if (!strcmp(type, "ULong_t"))   fType = kULong;
+  else if (!strcmp(type, "Long64_t"))  fType = kLong64;
+  else if (!strcmp(type, "ULong64_t")) fType = kULong64;
+  else if (!strcmp(type, "Float_t"))   fType = kFloat;
+  else if (!strcmp(type, "Double_t"))  fType = kDouble;
+  return true;
+}
+
+template <typename T>
+void RawLeafArray::Convert(int n)
+{
+  const T* buffer = static_cast<const T*>(fLeaf->GetValuePointer());
+  for (int i = 0; i < n; i++) fValues[i] = buffer[i];
+}
+
+void RawLeafArray::Read(int n)
+{
+  if (int(fValues.size()) < n) fValues.resize(n);
+  switch (fType)
+  {
+    case kBool:    Convert<Bool_t>(n);    break;
+    case kChar:    Convert<Char_t>(n);    break;
+    case kUChar:   Convert<UChar_t>(n);   break;
+    case kShort:   Convert<Short_t>(n);   break;
+    case kUShort:  Convert<UShort_t>(n);  break;
+    case kInt:     Convert<Int_t>(n);     break;
+    case kUInt:    Convert<UInt_t>(n);    break;
+    case kLong:    Convert<Long_t>(n);    break;
+    case kULong:   Convert<ULong_t>(n);   break;
+    case kLong64:  Convert<Long64_t>(n);  break;
+    case kULong64: Convert<ULong64_t>(n); break;
+    case kFloat:   Convert<Float_t>(n);   break;
+    case kDouble:  Convert<Double_t>(n);  break;
+    // unknown leaf type, fall back to the generic (slower) accessor
+    default: for (int i = 0; i < n; i++) fValues[i] = fLeaf->GetValue(i);
+  }
+}
+
+bool RawHitArrays::Bind(TTree* tree, bool withBoardId, bool withCalibrated)
+{
+  bool ok = nHits.Bind(tree, "nHits");
+  if (withBoardId) ok = boardId.Bind(tree, "boardId") && ok;
+  ok = tofpetId.Bind(tree, "tofpetId") && ok;
+  ok = tofpetChannel.Bind(tree, "tofpetChannel") && ok;
+  ok = tac.Bind(tree, "tac") && ok;
+  ok = tCoarse.Bind(tree, "tCoarse") && ok;
+  ok = tFine.Bind(tree, "tFine") && ok;
+  ok = vCoarse.Bind(tree, "vCoarse") && ok;
+  ok = vFine.Bind(tree, "vFine") && ok;
+  if (withCalibrated)
+  {
+    ok = timestamp.Bind(tree, "timestamp") && ok;
+    ok = value.Bind(tree, "value") && ok;
+  }
+  return ok;
+}
+
+int RawHitArrays::Read()
+{
+  nHits.Read(1);
+  int n = nHits[0];
+  if (boardId.IsBound()) boardId.Read(n);
+  tofpetId.Read(n);
+  tofpetChannel.Read(n);
+  tac.Read(n);
+  tCoarse.Read(n);
+  tFine.Read(n);
+  vCoarse.Read(n);
+  vFine.Read(n);
+  if (timestamp.IsBound()) timestamp.Read(n);
+  if (value.IsBound()) value.Read(n);
+  return n;
+}
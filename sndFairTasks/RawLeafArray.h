@@ -0,0 +1,49 @@
+#ifndef RAWLEAFARRAY_H_
+#define RAWLEAFARRAY_H_
+
+#include <TTree.h>
+#include <TLeaf.h>
+#include <vector>
+
+using namespace std;
+
+/** Leaf of a raw-data tree, resolved by name once and read as a plain array.
+    After the tree entry is loaded, Read(n) converts the first n values
+    from the leaf buffer in a single typed loop. **/
+class RawLeafArray
+{
+  public:
+    RawLeafArray() {}
+
+    /** Resolve the leaf, returns false if the tree has no such leaf **/
+    bool Bind(TTree* tree, const char* name);
+    /** Copy the first n values of the current entry **/
+    void Read(int n);
+    bool IsBound() const { return fLeaf != nullptr; }
+    double operator[](int i) const { return fValues[i]; }
+
+  private:
+    enum EType { kOther, kBool, kChar, kUChar, kShort, kUShort, kInt, kUInt,
+                 kLong, kULong, kLong64, kULong64, kFloat, kDouble };
+    template <typename T> void Convert(int n);
+
+    TLeaf* fLeaf{nullptr};
+    EType fType{kOther};
+    vector<double> fValues{};
+};
+
+/** All hit leaves of the raw-data format, shared by the old per-board
+    trees and the new "data" tree (which has boardId in addition). **/
+struct RawHitArrays
+{
+    RawLeafArray nHits, boardId, tofpetId, tofpetChannel, tac;
+    RawLeafArray tCoarse, tFine, vCoarse, vFine, timestamp, value;
+
+    /** Resolve every leaf of the tree, returns false if one is missing.
+        timestamp and value (online calibrated data) are only bound on request. **/
+    bool Bind(TTree* tree, bool withBoardId, bool withCalibrated);
+    /** Read the current entry, returns the number of hits **/
+    int Read();
+};
+
+#endif /* RAWLEAFARRAY_H_ */